@@ -18,10 +18,11 @@
 #include <vector>
 #include <deque>
 #include <string>
+#include <array>  // array class
 #include <pcg/pcg_random.hpp> // pcg prng
 
 #include "jackalope_types.h" // integer types
-#include "pcg.h"  // pcg seeding
+#include "pcg.h"  // pcg seeding, bits_to_index
 #include "util.h"  // str_stop
 
 
@@ -51,22 +52,36 @@ public:
 
     // Actual alias sampling
     inline uint64 sample(pcg64& eng) const {
-        // Fair dice roll from n-sided die
-        uint64 i = runif_01(eng) * n;
-        // uniform in range (0,1)
-        double u = runif_01(eng);
-        if (u < Prob[i]) return(i);
+        return sample_bits(eng());
+    };
+    /*
+     Alias sampling from one raw 64-bit draw (e.g., from `RngBuffer`).
+     The top 32 bits are a fair dice roll from the n-sided die, and
+     the bottom 32 bits are the biased coin flip.
+     */
+    inline uint64 sample_bits(const uint64& bits) const {
+        uint64 i = bits_to_index(bits, n);
+        if ((bits & 0xFFFFFFFFULL) < Prob[i]) return i;
         return Alias[i];
     };
 
 private:
-    std::vector<double> Prob;
+    /*
+     Probabilities of keeping column `i` (rather than using its alias),
+     scaled to integers out of 2^32 so they can be compared to the bottom 32 bits
+     of a draw.
+     */
+    std::vector<uint64> Prob;
     std::vector<uint64> Alias;
     uint64 n;
 
 
     void construct(arma::rowvec& p) {
 
+        if (n > 4294967296ULL) {
+            stop("AliasSampler can't sample from more than 2^32 items.");
+        }
+
         p /= arma::accu(p);  // make sure they sum to 1
         p *= n;
 
@@ -84,7 +99,7 @@ private:
             Small.pop_front();
             g = Large.front();
             Large.pop_front();
-            Prob[l] = p(l);
+            Prob[l] = static_cast<uint64>(p(l) * 4294967296.0);
             Alias[l] = g;
             p(g) = (p(g) + p(l)) - 1;
             if (p(g) < 1) {
@@ -94,13 +109,83 @@ private:
         while (!Large.empty()) {
             g = Large.front();
             Large.pop_front();
-            Prob[g] = 1;
+            Prob[g] = 4294967296ULL;
         }
         while (!Small.empty()) {
             l = Small.front();
             Small.pop_front();
-            Prob[l] = 1;
+            Prob[l] = 4294967296ULL;
+        }
+
+        return;
+    }
+};
+
+
+
+
+/*
+ Same as above, but for a number of items (`N`) that's known at compile time.
+ Everything is stored in `std::array`s, so making, copying, and sampling from
+ these objects doesn't allocate any memory.
+ Apart from rounding, its table is the same as that of an `AliasSampler` made from
+ the same probabilities.
+ */
+template <uint32 N>
+class FixedAliasSampler {
+public:
+    FixedAliasSampler() : Prob(), Alias() {};
+    FixedAliasSampler(const std::array<double, N>& probs) : Prob(), Alias() {
+        construct(probs);
+    }
+
+    inline uint64 sample(pcg64& eng) const {
+        return sample_bits(eng());
+    };
+    // Same as `AliasSampler::sample_bits`
+    inline uint64 sample_bits(const uint64& bits) const {
+        uint64 i = bits_to_index(bits, N);
+        if ((bits & 0xFFFFFFFFULL) < Prob[i]) return i;
+        return Alias[i];
+    };
+
+private:
+    std::array<uint64, N> Prob;
+    std::array<uint64, N> Alias;
+
+    /*
+     Vose's method as in `AliasSampler::construct`, but with fixed-size queues.
+     Each item is added to a queue at most once plus once per time it's a
+     "Large" item being paired, so 2N spaces is plenty.
+     */
+    void construct(std::array<double, N> p) {
+
+        double total = 0;
+        for (const double& pp : p) total += pp;
+        for (double& pp : p) pp = (pp / total) * N;
+
+        std::array<uint32, 2*N> Small;
+        std::array<uint32, 2*N> Large;
+        uint32 s0 = 0, s1 = 0, g0 = 0, g1 = 0;  // fronts and backs of queues
+        for (uint32 i = 0; i < N; i++) {
+            if (p[i] < 1) {
+                Small[s1++] = i;
+            } else Large[g1++] = i;
+        }
+
+        uint32 l, g;
+        while (s0 < s1 && g0 < g1) {
+            l = Small[s0++];
+            g = Large[g0++];
+            Prob[l] = static_cast<uint64>(p[l] * 4294967296.0);
+            Alias[l] = g;
+            p[g] = (p[g] + p[l]) - 1;
+            if (p[g] < 1) {
+                Small[s1++] = g;
+            } else Large[g1++] = g;
         }
+        while (g0 < g1) Prob[Large[g0++]] = 4294967296ULL;
+        while (s0 < s1) Prob[Small[s0++]] = 4294967296ULL;
 
         return;
     }
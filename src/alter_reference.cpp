@@ -235,39 +235,34 @@ void replace_Ns_cpp(SEXP ref_genome_ptr,
     // Check that # threads isn't too high and change to 1 if not using OpenMP:
     thread_check(n_threads);
 
-    // Generate seeds for random number generators (1 RNG per thread)
-    const std::vector<std::vector<uint64>> seeds = mt_seeds(n_threads);
+    // RNG streams (1 per chromosome, so output doesn't depend on # threads)
+    const RngStreams streams;
 
     const uint64 n_chroms = ref_genome->size();
 
     // Progress bar
     Progress prog_bar(ref_genome->total_size, show_progress);
 
+    // Do largest chromosomes first:
+    std::vector<uint64> sizes(n_chroms);
+    for (uint64 i = 0; i < n_chroms; i++) sizes[i] = ref_genome->chromosomes[i].size();
+    const std::vector<uint64> order = cost_order(sizes);
+
 #ifdef _OPENMP
 #pragma omp parallel num_threads(n_threads) if (n_threads > 1)
 {
 #endif
 
-    std::vector<uint64> active_seeds;
-
-    // Write the active seed per thread or just write one of the seeds.
-#ifdef _OPENMP
-    uint64 active_thread = omp_get_thread_num();
-#else
-    uint64 active_thread = 0;
-#endif
-    active_seeds = seeds[active_thread];
-
-    pcg64 eng = seeded_pcg(active_seeds);
-
     // Samples for nucleotides:
     AliasStringSampler<std::string> sampler("TCAG", pi_tcag);
 
 #ifdef _OPENMP
-#pragma omp for schedule(static)
+#pragma omp for schedule(dynamic)
 #endif
-    for (uint64 i = 0; i < n_chroms; i++) {
+    for (uint64 k = 0; k < n_chroms; k++) {
         if (prog_bar.is_aborted() || prog_bar.check_abort()) continue;
+        const uint64& i(order[k]);
+        pcg64 eng = streams.engine(jlp::rng_replace_Ns, i);
         RefChrom& chrom(ref_genome->chromosomes[i]);
         for (char& c : chrom.nucleos) {
             if (c == 'N') c = sampler.sample(eng);
@@ -23,7 +23,7 @@
 #include "jackalope_types.h"  // integer types
 #include "ref_classes.h"  // Ref* classes
 #include "alias_sampler.h" // alias sampling
-#include "pcg.h" // pcg::max, mt_seeds, seeded_pcg
+#include "pcg.h" // RngStreams, RngBuffer
 #include "util.h" // thread_check
 
 using namespace Rcpp;
@@ -66,8 +66,8 @@ OuterClass create_chromosomes_(const uint64& n_chroms,
     // Check that # threads isn't too high and change to 1 if not using OpenMP:
     thread_check(n_threads);
 
-    // Generate seeds for random number generators (1 RNG per thread)
-    const std::vector<std::vector<uint64>> seeds = mt_seeds(n_threads);
+    // RNG streams (1 per chromosome, so output doesn't depend on # threads)
+    const RngStreams streams;
 
     Progress prog_bar(n_chroms, false); // just use as way to check for abort
 
@@ -81,52 +81,52 @@ OuterClass create_chromosomes_(const uint64& n_chroms,
     const double gamma_shape = (len_mean * len_mean) / (len_sd * len_sd);
     const double gamma_scale = (len_sd * len_sd) / len_mean;
 
+    /*
+     Get chromosome lengths first, so the longest ones can be made first.
+     Each chromosome's engine is kept so its sequence continues from the
+     same stream used to get its length.
+     */
+    std::vector<pcg64> engines;
+    engines.reserve(n_chroms);
+    std::vector<uint64> lens(n_chroms, static_cast<uint64>(len_mean));
+    for (uint64 i = 0; i < n_chroms; i++) {
+        engines.push_back(streams.engine(jlp::rng_create_chroms, i));
+        if (len_sd > 0) {
+            // Gamma distribution for size selection (doi: 10.1093/molbev/msr011):
+            std::gamma_distribution<double> distr(gamma_shape, gamma_scale);
+            lens[i] = static_cast<uint64>(distr(engines[i]));
+            if (lens[i] < 1) lens[i] = 1;
+        }
+    }
+    const std::vector<uint64> order = cost_order(lens);
+
 
     #ifdef _OPENMP
     #pragma omp parallel default(shared) num_threads(n_threads) if (n_threads > 1)
     {
     #endif
 
-    std::vector<uint64> active_seeds;
-
-    // Write the active seed per thread or just write one of the seeds.
-    #ifdef _OPENMP
-    uint64 active_thread = omp_get_thread_num();
-    active_seeds = seeds[active_thread];
-    #else
-    active_seeds = seeds[0];
-    #endif
-
-    pcg64 engine = seeded_pcg(active_seeds);
-    // Gamma distribution to be used for size selection (doi: 10.1093/molbev/msr011):
-    std::gamma_distribution<double> distr;
-    if (len_sd > 0) {
-        distr = std::gamma_distribution<double>(gamma_shape, gamma_scale);
-    }
-
     std::string bases_ = jlp::bases;
 
     // Parallelize the Loop
     #ifdef _OPENMP
-    #pragma omp for schedule(static)
+    #pragma omp for schedule(dynamic)
     #endif
-    for (uint64 i = 0; i < n_chroms; i++) {
+    for (uint64 k = 0; k < n_chroms; k++) {
 
         if (prog_bar.is_aborted() || prog_bar.check_abort()) continue;
 
+        const uint64& i(order[k]);
         InnerClass& chrom(chroms_out[i]);
+        pcg64& engine(engines[i]);
+        RngBuffer rng;
 
-        // Get length of output chromosome:
-        uint64 len;
-        if (len_sd > 0) {
-            len = static_cast<uint64>(distr(engine));
-            if (len < 1) len = 1;
-        } else len = len_mean;
         // Sample chromosome:
+        const uint64& len(lens[i]);
         chrom.reserve(len);
         for (uint64 j = 0; j < len; j++) {
-            uint64 k = sampler.sample(engine);
-            chrom.push_back(bases_[k]);
+            uint64 b = sampler.sample_bits(rng.next(engine));
+            chrom.push_back(bases_[b]);
         }
     }
 
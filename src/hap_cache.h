@@ -0,0 +1,162 @@
+#ifndef __JACKALOPE_HAP_CACHE_H
+#define __JACKALOPE_HAP_CACHE_H
+
+
+#include "jackalope_config.h" // controls debugging and diagnostics output
+
+/*
+ ********************************************************
+
+ Cache of full haplotype chromosome sequences, shared among threads.
+
+ ********************************************************
+ */
+
+#include <RcppArmadillo.h>
+#include <vector>  // vector class
+#include <string>  // string class
+#include <list>  // list class (for LRU order)
+#include <memory>  // shared_ptr, make_shared
+#include <mutex>  // mutex, lock_guard, once_flag, call_once
+
+#include "jackalope_types.h"  // integer types
+#include "hap_classes.h"  // Hap* classes
+
+
+using namespace Rcpp;
+
+
+namespace jlp {
+    // Default maximum # bytes of chromosome sequences kept in a `HapChromCache`
+    const uint64 hap_cache_bytes = 2147483648ULL;  // 2 GB
+}
+
+
+/*
+ Stores full sequences for haplotype chromosomes so that multiple threads making
+ reads from the same chromosome share one copy, and so that a chromosome
+ isn't re-created each time a thread comes back to it.
+
+ Sequences are handed out as `std::shared_ptr<const std::string>`, so they stay
+ valid for as long as a thread holds onto them, even after they're evicted.
+ When the total size of sequences exceeds `max_bytes`, the least recently used
+ sequences that no thread is using are removed.
+ (Sequences in use are never removed, so if they alone exceed `max_bytes`,
+ memory usage will temporarily go over this limit.)
+
+ The `HapSet` must not change while this object is in use.
+ */
+class HapChromCache {
+
+public:
+
+    typedef std::shared_ptr<const std::string> SeqPtr;
+
+    HapChromCache(const HapSet& hap_set,
+                  const uint64& max_bytes_ = jlp::hap_cache_bytes)
+        : haplotypes(&hap_set),
+          max_bytes(max_bytes_),
+          n_bytes(0),
+          entries(hap_set.size()),
+          lru(),
+          mtx() {
+        for (uint64 i = 0; i < hap_set.size(); i++) {
+            entries[i].reserve(hap_set[i].size());
+            for (uint64 j = 0; j < hap_set[i].size(); j++) {
+                entries[i].push_back(std::make_shared<Entry>());
+            }
+        }
+    }
+
+    // This class isn't meant to be copied; share it using a `shared_ptr` instead.
+    HapChromCache(const HapChromCache&) = delete;
+    HapChromCache& operator=(const HapChromCache&) = delete;
+
+    /*
+     Get sequence for chromosome `chrom_i` from haplotype `hap_i`.
+     Only one thread creates a given sequence; others asking for it at the
+     same time wait for it to finish.
+     */
+    SeqPtr get(const uint64& hap_i, const uint64& chrom_i) {
+
+        std::shared_ptr<Entry> entry;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            entry = entries[hap_i][chrom_i];
+            touch__(hap_i, chrom_i, *entry);
+        }
+
+        std::call_once(entry->made, [&]() {
+            entry->seq = std::make_shared<const std::string>(
+                (*haplotypes)[hap_i][chrom_i].get_chrom_full());
+        });
+
+        SeqPtr out = entry->seq;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!entry->counted) {
+                n_bytes += out->size();
+                entry->counted = true;
+            }
+            evict__();
+        }
+
+        return out;
+    }
+
+
+private:
+
+    struct Entry {
+        std::once_flag made;
+        SeqPtr seq;
+        bool counted;  // whether `seq` is included in `n_bytes`
+        bool in_lru;
+        std::list<std::pair<uint64,uint64>>::iterator lru_it;
+        Entry() : made(), seq(), counted(false), in_lru(false), lru_it() {};
+    };
+
+    const HapSet* haplotypes;
+    uint64 max_bytes;
+    uint64 n_bytes;
+    std::vector<std::vector<std::shared_ptr<Entry>>> entries;
+    // Haplotype and chromosome indices, from most to least recently used:
+    std::list<std::pair<uint64,uint64>> lru;
+    std::mutex mtx;
+
+    // Move an entry to the front of `lru` (`mtx` must be locked)
+    void touch__(const uint64& hap_i, const uint64& chrom_i, Entry& entry) {
+        if (entry.in_lru) lru.erase(entry.lru_it);
+        lru.push_front(std::make_pair(hap_i, chrom_i));
+        entry.lru_it = lru.begin();
+        entry.in_lru = true;
+        return;
+    }
+
+    /*
+     Remove least recently used sequences until we're within `max_bytes`
+     (`mtx` must be locked).
+     Entries are replaced rather than reset, so a thread still inside
+     `std::call_once` for an old entry can't interfere with a new one.
+     */
+    void evict__() {
+        auto it = lru.end();
+        while (n_bytes > max_bytes && it != lru.begin()) {
+            --it;
+            std::shared_ptr<Entry>& entry(entries[it->first][it->second]);
+            // Skip ones that are in use or still being made:
+            if (!entry->counted || entry->seq.use_count() > 1) continue;
+            n_bytes -= entry->seq->size();
+            it = lru.erase(it);
+            entry = std::make_shared<Entry>();
+        }
+        return;
+    }
+
+};
+
+
+
+
+#endif
@@ -13,9 +13,10 @@
 #include <RcppArmadillo.h>
 #include <vector>  // vector class
 #include <string>  // string class
-#include <cstring>  // C strings, including std::strcpy
-#include <algorithm>  // lower_bound, sort
+#include <cstring>  // C strings, including std::strcpy, std::memcpy
+#include <algorithm>  // lower_bound, sort, min, max
 #include <deque>  // deque
+#include <utility>  // move
 
 
 #include "jackalope_types.h"  // integer types
@@ -36,28 +37,42 @@ using namespace Rcpp;
 // this `HapChrom` must be empty after `mut_i`
 // return `sint64` is the size modifier for mutations added
 sint64 HapChrom::add_to_back(const HapChrom& other, const uint64& mut_i) {
+    return add_to_back(other, mut_i, other.mutations.size());
+}
+// Same as above, but only up to mutation index `mut_end - 1`
+sint64 HapChrom::add_to_back(const HapChrom& other, const uint64& mut_i,
+                             const uint64& mut_end) {
 
-    if (other.mutations.size() <= mut_i) return 0;
+    if (other.mutations.size() <= mut_i || mut_end <= mut_i) return 0;
 
     if (!mutations.empty() &&
-        mutations.old_pos.back() >= other.mutations.old_pos[mut_i]) {
+        mutations.old_pos(mutations.size() - 1) >= other.mutations.old_pos(mut_i)) {
         str_stop({"\nOverlapping HapChrom.mutations in HapChrom::add_to_back. ",
                  "Note that when combining HapChrom objects using `add_to_back`, you ",
                  "must do it sequentially, from the back ONLY."});
     }
 
-    sint64 new_size_mod = 0;
     sint64 old_size_mod = static_cast<sint64>(chrom_size) -
         static_cast<sint64>(ref_chrom->size());
-
-    for (uint64 i = mut_i; i < other.mutations.size(); i++) {
-        mutations.push_back(other.mutations.old_pos[i],
-                            other.mutations.new_pos[i],
-                            other.mutations.nucleos[i]);
-        mutations.new_pos.back() = mutations.old_pos.back() +
-            old_size_mod + new_size_mod;
-        new_size_mod += other.size_modifier(i);
+    // Size modification in `other` from mutations before `mut_i`:
+    sint64 before_size_mod = static_cast<sint64>(other.mutations.new_pos(mut_i)) -
+        static_cast<sint64>(other.mutations.old_pos(mut_i));
+    // ... and from mutations before `mut_end`:
+    sint64 after_size_mod;
+    if (mut_end < other.mutations.size()) {
+        after_size_mod = static_cast<sint64>(other.mutations.new_pos(mut_end)) -
+            static_cast<sint64>(other.mutations.old_pos(mut_end));
+    } else {
+        after_size_mod = static_cast<sint64>(other.chrom_size) -
+            static_cast<sint64>(other.ref_chrom->size());
     }
+    sint64 new_size_mod = after_size_mod - before_size_mod;
+
+    /*
+     This shares (rather than copies) mutation blocks with `other`, so
+     haplotypes with shared ancestry don't duplicate their shared mutations.
+     */
+    mutations.append(other.mutations, mut_i, mut_end, old_size_mod - before_size_mod);
 
     chrom_size += new_size_mod;
 
@@ -81,36 +96,9 @@ std::string HapChrom::get_chrom_full() const {
 
     if (mutations.empty()) return ref_chrom->nucleos;
 
-    // Index to the first Mutation object
+    std::string out(chrom_size, '\0');
     uint64 mut_i = 0;
-
-    std::string out;
-    out.reserve(chrom_size);
-    uint64 pos = 0;
-
-    // Picking up any nucleotides before the first mutation
-    while (pos < mutations.new_pos[mut_i]) {
-        out.push_back((*ref_chrom)[pos]);
-        ++pos;
-    }
-
-    // Now, for each subsequent mutation except the last, add all nucleotides
-    // at or after its position but before the next one
-    uint64 next_mut_i = mut_i + 1;
-    while (next_mut_i < mutations.size()) {
-        while (pos < mutations.new_pos[next_mut_i]) {
-            out.push_back(get_char_(pos, mut_i));
-            ++pos;
-        }
-        ++mut_i;
-        ++next_mut_i;
-    }
-
-    // Now taking care of nucleotides after the last Mutation
-    while (pos < chrom_size) {
-        out.push_back(get_char_(pos, mut_i));
-        ++pos;
-    }
+    if (chrom_size > 0) fill_range_(&out[0], 0, chrom_size, mut_i);
 
     return out;
 }
@@ -122,13 +110,11 @@ std::string HapChrom::get_chrom_full() const {
 /*
  ------------------
  Set an input string object to any chunk of a chromosome from the haplotype chromosome.
- Before anything, this function moves `mut` to the location right before this chunk's
- starting position. I keep this index around so I don't have to iterate through
- the entire mutation deque multiple times.
+ Afterward, `mut_i` is the index to the last mutation used for this chunk.
  If end position is beyond the size of the chromosome, it changes `chunk_str` to the
  chromosome from the start to the chromosome end.
- If start position is beyond the size of the chromosome, it sets `mut` to
- `mutations.end()` and clears `chunk_str`.
+ If start position is beyond the size of the chromosome, it sets `mut_i` to
+ `mutations.size()` and clears `chunk_str`.
  ------------------
  */
 void HapChrom::set_chrom_chunk(std::string& chunk_str,
@@ -150,53 +136,13 @@ void HapChrom::set_chrom_chunk(std::string& chunk_str,
 
     // No need to mess around with mutations if there aren't any
     if (mutations.empty()) {
-        chunk_str = ref_chrom->nucleos.substr(start, out_length);
+        chunk_str.assign(ref_chrom->nucleos, start, out_length);
         return;
     }
-    // Move mutation to the proper spot
-    while (mut_i < mutations.size()) {
-        if (start < mutations.new_pos[mut_i]) break;
-        ++mut_i;
-    }
-    if (mut_i != 0) --mut_i;
-    // Clearing string if necessary (reserving memory should happen outside this method)
-    if (chunk_str.size() > 0) chunk_str.clear();
-
-    uint64 pos = start;
-    uint64 next_mut_i = mut_i + 1;
-
-    /*
-     Picking up any nucleotides before the focal mutation (this should only happen when
-     `mut == mutations.begin()` and `start` is before the first mutation)
-     */
-    while (pos < mutations.new_pos[mut_i] && pos <= end) {
-        chunk_str += (*ref_chrom)[pos];
-        ++pos;
-    }
-    if (pos > end) return;
 
-    /*
-     Now, for each subsequent mutation except the last, add all nucleotides
-     at or after its position (and `end`) but before the next mutation
-     */
-    while (next_mut_i < mutations.size()) {
-        while (pos < mutations.new_pos[next_mut_i] && pos <= end) {
-            chunk_str += get_char_(pos, mut_i);
-            ++pos;
-        }
-        if (pos > end) return;
-        ++mut_i;
-        ++next_mut_i;
-    }
-
-    /*
-     If we reach the last mutation, add nucleotides until `end` (remember that above,
-     I've made sure that `end < chrom_size`).
-     */
-    while (pos <= end) {
-        chunk_str += get_char_(pos, mut_i);
-        ++pos;
-    }
+    // (Reserving memory should happen outside this method)
+    chunk_str.resize(out_length);
+    fill_range_(&chunk_str[0], start, out_length, mut_i);
 
     return;
 }
@@ -216,70 +162,113 @@ void HapChrom::fill_read(std::string& read,
                             const uint64& chrom_start,
                             uint64 n_to_add) const {
 
-    uint64 mut_i = 0;
-
-    uint64 chrom_end = chrom_start + n_to_add - 1;
     // Making sure chrom_end doesn't go beyond the chromosome bounds
-    if (chrom_end >= chrom_size) {
-        chrom_end = chrom_size - 1;
+    if ((chrom_start + n_to_add - 1) >= chrom_size) {
         n_to_add = chrom_size - chrom_start;
     }
 
     // Make sure the read is long enough (this fxn should never shorten it):
     if (read.size() < n_to_add + read_start) read.resize(n_to_add + read_start, 'N');
 
+    if (n_to_add == 0) return;
+
     // No need to mess around with mutations if there aren't any
     if (mutations.empty()) {
-        for (uint64 i = 0; i < n_to_add; i++) {
-            read[(read_start + i)] = ref_chrom->nucleos[(chrom_start + i)];
-        }
+        std::memcpy(&read[read_start], ref_chrom->nucleos.data() + chrom_start,
+                    n_to_add);
         return;
     }
-    // Move mutation to the proper spot
-    while (mut_i < mutations.size()) {
-        if (chrom_start < mutations.new_pos[mut_i]) break;
-        ++mut_i;
-    }
-    if (mut_i != 0) --mut_i;
 
-    uint64 chrom_pos = chrom_start;
-    uint64 read_pos = read_start;
-    uint64 next_mut_i = mut_i + 1;
+    uint64 mut_i = 0;
+    fill_range_(&read[read_start], chrom_start, n_to_add, mut_i);
 
-    /*
-     Picking up any nucleotides before the focal mutation (this should only happen when
-     `mut == mutations.begin()` and `chrom_start` is before the first mutation)
-     */
-    while (chrom_pos < mutations.new_pos[mut_i] && chrom_pos <= chrom_end) {
-        read[read_pos] = (*ref_chrom)[chrom_pos];
-        ++chrom_pos;
-        ++read_pos;
+    return;
+}
+
+
+
+
+/*
+ ------------------
+ Inner function to copy part of the haplotype chromosome
+ (positions `start` to `start + n - 1`, which must all be `< chrom_size`) to `out`.
+ Rather than going one nucleotide at a time, this copies runs of nucleotides:
+ one run for each mutation's nucleotides, and one for each stretch of reference
+ chromosome between mutations.
+ Afterward, `mut_i` is the index to the last mutation used (or `0` if
+ none were used).
+ ------------------
+ */
+void HapChrom::fill_range_(char* out,
+                           const uint64& start,
+                           const uint64& n,
+                           uint64& mut_i) const {
+
+    const char* ref = ref_chrom->nucleos.data();
+    uint64 pos = start;
+    uint64 end = start + n;  // not inclusive
+
+    mut_i = get_mut_(start);
+
+    // Picking up any nucleotides before the first mutation:
+    if (mut_i == mutations.size()) {
+        mut_i = 0;
+        uint64 run_end = std::min(end, mutations.new_pos(0));
+        std::memcpy(out, ref + pos, run_end - pos);
+        out += (run_end - pos);
+        pos = run_end;
     }
-    if (chrom_pos > chrom_end) return;
 
     /*
-     Now, for each subsequent mutation except the last, add all nucleotides
-     at or after its position (and `chrom_end`) but before the next mutation
+     For each mutation, nucleotides from its position up to (but not including)
+     the next mutation's position are the mutation's nucleotides (when it's
+     not a deletion), followed by reference nucleotides.
+     `cum_mod` is the total size modification from all mutations before this one.
      */
-    while (next_mut_i < mutations.size()) {
-        while (chrom_pos < mutations.new_pos[next_mut_i] && chrom_pos <= chrom_end) {
-            read[read_pos] = get_char_(chrom_pos, mut_i);
-            ++chrom_pos;
-            ++read_pos;
+    uint64 np = mutations.new_pos(mut_i);
+    sint64 cum_mod = static_cast<sint64>(np) -
+        static_cast<sint64>(mutations.old_pos(mut_i));
+    while (pos < end) {
+        uint64 next_np;
+        sint64 next_cum_mod;
+        if ((mut_i + 1) < mutations.size()) {
+            uint64 next_op;
+            mutations.positions(mut_i + 1, next_op, next_np);
+            next_cum_mod = static_cast<sint64>(next_np) -
+                static_cast<sint64>(next_op);
+        } else {
+            next_np = chrom_size;
+            next_cum_mod = static_cast<sint64>(chrom_size) -
+                static_cast<sint64>(ref_chrom->size());
         }
-        if (chrom_pos > chrom_end) return;
+        sint64 size_mod = next_cum_mod - cum_mod;
+        uint64 seg_end = std::min(end, next_np);
+        // Mutation's own nucleotides:
+        if (size_mod >= 0) {
+            uint64 nt_end = std::min(seg_end, np + static_cast<uint64>(size_mod) + 1);
+            if (pos < nt_end) {
+                const char* nts = mutations.nucleos_data(mut_i);
+                if (nts == nullptr) {
+                    std::string err_msg = "mutations.nucleos_size(mut_i) == 0 at ";
+                    err_msg += std::to_string(mut_i);
+                    stop(err_msg.c_str());
+                }
+                std::memcpy(out, nts + (pos - np), nt_end - pos);
+                out += (nt_end - pos);
+                pos = nt_end;
+            }
+        }
+        // Reference nucleotides after them:
+        if (pos < seg_end) {
+            uint64 ref_pos = pos - static_cast<uint64>(next_cum_mod);
+            std::memcpy(out, ref + ref_pos, seg_end - pos);
+            out += (seg_end - pos);
+            pos = seg_end;
+        }
+        if (pos >= end) break;
         ++mut_i;
-        ++next_mut_i;
-    }
-
-    /*
-     If we reach the last mutation, add nucleotides until `chrom_end`
-     (remember that above, I've made sure that `chrom_end < chrom_size`).
-     */
-    while (chrom_pos <= chrom_end) {
-        read[read_pos] = get_char_(chrom_pos, mut_i);
-        ++chrom_pos;
-        ++read_pos;
+        np = next_np;
+        cum_mod = next_cum_mod;
     }
 
     return;
@@ -315,20 +304,20 @@ void HapChrom::add_deletion(const uint64& size_, const uint64& new_pos_) {
      If the first mutation is after the deletion,
      just add to the beginning, adjust the `new_pos`s, and adjust chromosome size
      */
-    if (mutations.new_pos.front() > deletion_end) {
+    if (mutations.new_pos(0) > deletion_end) {
 
         /*
          In the rare case where the first mutation is a deletion that's right after
          the new deletion, we don't need to add an extra mutation but we do need to
          adjust the first mutation's `old_pos`.
          */
-        bool del_after = mutations.new_pos.front() == (deletion_end + 1) &&
+        bool del_after = mutations.new_pos(0) == (deletion_end + 1) &&
             size_modifier(0) < 0;
 
-        for (uint64& np : mutations.new_pos) np += size_mod; // <-- gets done either way
+        mutations.shift_new_pos(0, size_mod); // <-- gets done either way
 
         if (del_after) {
-            mutations.old_pos.front() += size_mod;
+            mutations.set_old_pos(0, mutations.old_pos(0) + size_mod);
         } else {
             mutations.push_front(new_pos_, deletion_start, nullptr);
         }
@@ -341,22 +330,21 @@ void HapChrom::add_deletion(const uint64& size_, const uint64& new_pos_) {
      least partially removed by it.
      This is a weird situation that needs to be addressed explicitly.
      */
-    bool first_overlap = mutations.new_pos.front() > deletion_start &&
-        mutations.new_pos.front() <= deletion_end;
+    bool first_overlap = mutations.new_pos(0) > deletion_start &&
+        mutations.new_pos(0) <= deletion_end;
 
     /*
      (Not using `get_mut_` below bc we want the first mutation that's == `deletion_start`
       or, if that doesn't exist, the last one that's < `deletion_start`.)
      */
     uint64 mut_i;
-    if (mutations.new_pos.back() < deletion_start) {
+    if (mutations.new_pos(mutations.size() - 1) < deletion_start) {
         mut_i = mutations.size() - 1;
     } else {
-        mut_i = 0;
-        // Iterate until the first mutation that's >= `deletion_start`
-        while (mutations.new_pos[mut_i] < deletion_start) ++mut_i;
+        // First mutation that's >= `deletion_start`
+        mut_i = mutations.lower_bound_new(deletion_start);
         // Go back one if it's > `deletion_start` (But not if `mut_i` is zero!)
-        if (mutations.new_pos[mut_i] > deletion_start && mut_i > 0) --mut_i;
+        if (mutations.new_pos(mut_i) > deletion_start && mut_i > 0) --mut_i;
     }
 
     // Getting old position info before changing any mutation info
@@ -370,10 +358,14 @@ void HapChrom::add_deletion(const uint64& size_, const uint64& new_pos_) {
      */
     std::vector<uint64> rm_inds;
     sint64 size_mod_remaining = size_mod; // to keep track of how much deletion remains
-    for (uint64 i = mut_i; i < mutations.size(); i++) {
+    uint64 i = mut_i;
+    for (; i < mutations.size(); i++) {
+        if (mutations.new_pos(i) > (deletion_end + 1)) break;
         deletion_one_mut_(i, deletion_start, deletion_end, size_mod,
                           size_mod_remaining, rm_inds);
     }
+    // Mutations after (and not next to) the deletion just need their positions moved:
+    mutations.shift_new_pos(i, size_mod);
 
     chrom_size += size_mod;
 
@@ -428,25 +420,17 @@ void HapChrom::add_insertion(const std::string& nucleos_, const uint64& new_pos_
         return;
     }
 
-    uint64 ind = new_pos_ - mutations.new_pos[mut_i];
+    uint64 ind = new_pos_ - mutations.new_pos(mut_i);
     /*
      If `new_pos_` is within the Mutation chromosome (which is never the case for
      deletions), then we adjust it as such:
      */
     if (static_cast<sint64>(ind) <= size_modifier(mut_i)) {
         // string to store combined nucleotides
-        std::string nts = "";
-        for (uint64 j = 0; j <= ind; j++) nts += mutations.nucleos[mut_i][j];
-        nts += nucleos_;
-        uint64 nucleos_size = std::strlen(mutations.nucleos[mut_i]);
-        for (uint64 j = ind + 1; j < nucleos_size; j++) {
-            nts += mutations.nucleos[mut_i][j];
-        }
+        std::string nts = mutations.get_nucleos(mut_i);
+        nts.insert(ind + 1, nucleos_);
         // Update nucleos field:
-        delete [] mutations.nucleos[mut_i]; // delete old char array
-        mutations.nucleos[mut_i] = new char[nts.size() + 1];
-        std::copy(nts.begin(), nts.end(), mutations.nucleos[mut_i]);
-        mutations.nucleos[mut_i][nts.size()] = '\0';
+        mutations.set_nucleos(mut_i, nts);
         // Adjust new positions and total chromosome size:
         calc_positions(mut_i + 1, size_mod);
         /*
@@ -454,7 +438,7 @@ void HapChrom::add_insertion(const std::string& nucleos_, const uint64& new_pos_
          a new Mutation object:
          */
     } else {
-        uint64 old_pos_ = ind + (mutations.old_pos[mut_i] -
+        uint64 old_pos_ = ind + (mutations.old_pos(mut_i) -
             size_modifier(mut_i));
         std::string nts = (*ref_chrom)[old_pos_] + nucleos_;
         ++mut_i;
@@ -484,7 +468,7 @@ void HapChrom::add_substitution(const char& nucleo, const uint64& new_pos_) {
         // (below, notice that new position and old position are the same)
         mutations.push_front(new_pos_, new_pos_, nucleo);
     } else {
-        uint64 ind = new_pos_ - mutations.new_pos[mut_i];
+        uint64 ind = new_pos_ - mutations.new_pos(mut_i);
         // If `new_pos_` is within the mutation chromosome:
         if (static_cast<sint64>(ind) <= size_modifier(mut_i)) {
             /*
@@ -493,12 +477,12 @@ void HapChrom::add_substitution(const char& nucleo, const uint64& new_pos_) {
              Otherwise, adjust the mutation's sequence.
              */
             if ((size_modifier(mut_i) == 0) &&
-                (ref_chrom->nucleos[mutations.old_pos[mut_i]] == nucleo)) {
+                (ref_chrom->nucleos[mutations.old_pos(mut_i)] == nucleo)) {
                 mutations.erase(mut_i);
-            } else mutations.nucleos[mut_i][ind] = nucleo;
+            } else mutations.set_nucleo(mut_i, ind, nucleo);
             // If `new_pos_` is in the reference chromosome following the mutation:
         } else {
-            uint64 old_pos_ = ind + (mutations.old_pos[mut_i] -
+            uint64 old_pos_ = ind + (mutations.old_pos(mut_i) -
                 size_modifier(mut_i));
             ++mut_i;
             mutations.insert(mut_i, old_pos_, new_pos_, nucleo);
@@ -513,6 +497,281 @@ void HapChrom::add_substitution(const char& nucleo, const uint64& new_pos_) {
 
 
 
+/*
+ ------------------
+ Add many indels at once
+ ------------------
+ Rather than adding each indel to the full set of mutations (which has to move
+ all mutations after it), this builds a new set of mutations from front to back.
+ Before each indel is added, the existing mutations it could affect are moved
+ to the new set, so each indel only changes the last few mutations there.
+ Mutations between indels are moved in whole blocks where possible.
+ */
+void HapChrom::add_indels(const std::vector<Indel>& indels, const std::string& seqs) {
+
+    if (indels.empty()) return;
+
+    HapChrom out(*ref_chrom);
+    out.name = name;
+
+    // Index to the next mutation in this object that hasn't been moved to `out`:
+    uint64 mut_i = 0;
+    /*
+     Position in `out` minus position in this object, for positions between
+     the last moved mutation and the next one to be moved
+     */
+    sint64 shift = 0;
+
+    for (const Indel& indel : indels) {
+
+        /*
+         Last position (on this object) that this indel can affect.
+         This includes the position after a deletion because a deletion there
+         would be merged with it.
+         */
+        sint64 last = static_cast<sint64>(indel.pos) - shift;
+        if (!indel.insertion) last += static_cast<sint64>(indel.size);
+
+        if (last >= 0 && mut_i < mutations.size()) {
+            uint64 mut_end = mutations.upper_bound_new(static_cast<uint64>(last));
+            if (mut_end > mut_i) {
+                out.add_to_back(*this, mut_i, mut_end);
+                mut_i = mut_end;
+            }
+        }
+
+        if (indel.insertion) {
+            out.add_insertion(seqs.substr(indel.seq_start, indel.size), indel.pos);
+            shift += static_cast<sint64>(indel.size);
+        } else {
+            uint64 size0 = out.chrom_size;
+            out.add_deletion(indel.size, indel.pos);
+            shift -= static_cast<sint64>(size0 - out.chrom_size);
+        }
+
+    }
+
+    // The rest are moved unchanged:
+    out.add_to_back(*this, mut_i);
+
+    mutations = std::move(out.mutations);
+    chrom_size = out.chrom_size;
+
+    return;
+}
+
+
+
+
+/*
+ ------------------
+ Set a region of the chromosome from a dense copy of its nucleotides
+ ------------------
+ This is for when many sites in a region were changed in `seq` (a copy from
+ `set_chrom_chunk`), so adding each change as a substitution
+ would be slower than rebuilding the region's mutations in one pass.
+ Mutations in the region with size modifiers != 0 serve as a map of the indels
+ there: they're kept in place, and only the nucleotides of insertions are updated.
+ Old substitutions are dropped, and new ones are made for each site
+ from the reference that doesn't match `seq`.
+ Like `add_substitution`, this never stores a substitution to the
+ reference nucleotide.
+ */
+void HapChrom::set_region(const std::string& seq, const uint64& begin) {
+
+    if (seq.empty()) return;
+
+    const uint64 end = begin + seq.size();  // not inclusive
+    if (end > chrom_size) {
+        str_stop({"\nIn HapChrom::set_region, the region (", std::to_string(begin),
+                 " to ", std::to_string(end - 1), ") goes past the end of the ",
+                 "chromosome (size ", std::to_string(chrom_size), ")."});
+    }
+
+    const std::string& ref(ref_chrom->nucleos);
+    const uint64 n_muts = mutations.size();
+
+    // First mutation in the region (including an insertion that overlaps `begin`):
+    uint64 i0 = mutations.lower_bound_new(begin);
+    if (i0 > 0 && size_modifier(i0 - 1) > 0 &&
+        (mutations.new_pos(i0 - 1) + size_modifier(i0 - 1)) >= begin) {
+        --i0;
+    }
+    // First mutation after the region:
+    const uint64 i1 = mutations.lower_bound_new(end);
+
+    AllMutations out;
+    out.append(mutations, 0, i0, 0);
+
+    /*
+     Positions for mutation `i` (`op` and `np`) and for the one after it
+     (`next_op` and `next_np`) are carried through the loop, so each mutation
+     is only looked up once.
+     For the chromosome end, `np` is `chrom_size` and `op` is the reference size.
+     */
+    uint64 op = ref.size(), np = chrom_size;
+    if (i0 < n_muts) mutations.positions(i0, op, np);
+    uint64 next_op, next_np;
+
+    uint64 pos = begin;
+    for (uint64 i = i0; i <= i1; i++) {
+        /*
+         Reference nucleotides before mutation `i` (or before the chromosome end).
+         Substitutions don't change sizes, so ones that were skipped below
+         are simply part of this run.
+         */
+        const uint64 cum_mod = np - op;  // (wraps around if negative)
+        const uint64 run_end = std::min(np, end);
+        for (; pos < run_end; pos++) {
+            const char& nt(seq[pos - begin]);
+            if (nt != ref[pos - cum_mod]) out.push_back(pos - cum_mod, pos, nt);
+        }
+
+        if (i == i1) break;
+
+        next_op = ref.size();
+        next_np = chrom_size;
+        if ((i + 1) < n_muts) mutations.positions(i + 1, next_op, next_np);
+        const sint64 sm = static_cast<sint64>(next_np - next_op) -
+            static_cast<sint64>(cum_mod);
+
+        if (sm < 0) {
+            out.push_back(op, np, nullptr);
+        } else if (sm > 0) {
+            // Insertions get any of their nucleotides that are in the region updated:
+            std::string nts = mutations.get_nucleos(i);
+            for (uint64 j = 0; j < nts.size(); j++) {
+                if ((np + j) >= begin && (np + j) < end) nts[j] = seq[np + j - begin];
+            }
+            out.push_back(op, np, nts.c_str(), nts.size());
+            pos = std::max(pos, np + nts.size());
+        }
+
+        op = next_op;
+        np = next_np;
+    }
+
+    // Mutations after the region are unchanged:
+    out.append(mutations, i1, 0);
+
+    mutations = std::move(out);
+
+    return;
+}
+
+
+
+
+
+/*
+ ------------------
+ Add many mutations at positions on the reference
+ ------------------
+ Mutations in `muts` must be sorted by position, and any existing mutations
+ must be before all of them.
+ The result is the same as adding them one at a time from the back using
+ `add_substitution`, `add_insertion`, and `add_deletion` (followed by
+ `add_substitution` for insertions whose first nucleotide isn't the reference one).
+ Adding from the back means positions on the reference can be used directly,
+ and it decides what happens when mutations overlap (e.g., a deletion
+ removes mutations after it that it covers).
+
+ Rather than doing that, this goes from front to back and adds most mutations
+ directly to the end of `mutations`.
+ Only groups of mutations that can affect each other are added from the back,
+ and because they're near the end of `mutations`, that's also fast.
+ */
+void HapChrom::add_ref_mutations(const std::vector<RefMutation>& muts,
+                                 const std::string& seqs) {
+
+    if (muts.empty()) return;
+
+    if (!mutations.empty() &&
+        mutations.old_pos(mutations.size() - 1) >= muts.front().pos) {
+        str_stop({"\nIn HapChrom::add_ref_mutations, new mutations must all be ",
+                 "after existing ones."});
+    }
+
+    const std::string& ref(ref_chrom->nucleos);
+    const uint64 n = muts.size();
+
+    uint64 i = 0;
+    while (i < n) {
+
+        /*
+         Mutations `i` to `j - 1` can affect each other.
+         This happens when two are at the same position, when a deletion
+         reaches a later mutation, or when two deletions are next to each other
+         (they're then merged).
+         `reach` is one past the last reference position that this group
+         might affect.
+         Deletions inside the group extend it, since the first deletion removes
+         nucleotides on the chromosome, not the reference.
+         */
+        uint64 reach = muts[i].pos + 1;
+        if (muts[i].size_mod < 0) {
+            reach = muts[i].pos + static_cast<uint64>(-muts[i].size_mod);
+        }
+        uint64 j = i + 1;
+        while (j < n && (muts[j].pos < reach ||
+                         (muts[j].pos == reach && muts[j].size_mod < 0))) {
+            if (muts[j].size_mod < 0) {
+                reach = std::max(reach, muts[j].pos) +
+                    static_cast<uint64>(-muts[j].size_mod);
+            }
+            j++;
+        }
+
+        // Positions after `muts[i].pos` haven't been changed yet, so they
+        // differ from positions on the reference by this amount:
+        const sint64 shift = static_cast<sint64>(chrom_size) -
+            static_cast<sint64>(ref.size());
+
+        if (j == (i + 1)) {
+
+            const RefMutation& m(muts[i]);
+            const uint64 np = m.pos + shift;
+            if (m.size_mod == 0) {
+                mutations.push_back(m.pos, np, seqs[m.seq_start]);
+            } else if (m.size_mod > 0) {
+                mutations.push_back(m.pos, np, &seqs[m.seq_start],
+                                    static_cast<uint64>(m.size_mod) + 1);
+                chrom_size += m.size_mod;
+            } else if (np < chrom_size) {
+                // (Like `add_deletion`, this doesn't go past the chromosome end)
+                uint64 size = std::min(static_cast<uint64>(-m.size_mod),
+                                       chrom_size - np);
+                mutations.push_back(m.pos, np, nullptr);
+                chrom_size -= size;
+            }
+
+        } else {
+
+            for (uint64 k = j; k > i; k--) {
+                const RefMutation& m(muts[k-1]);
+                const uint64 np = m.pos + shift;
+                if (m.size_mod == 0) {
+                    add_substitution(seqs[m.seq_start], np);
+                } else if (m.size_mod > 0) {
+                    add_insertion(seqs.substr(m.seq_start + 1, m.size_mod), np);
+                    if (seqs[m.seq_start] != ref[m.pos]) {
+                        add_substitution(seqs[m.seq_start], np);
+                    }
+                } else add_deletion(static_cast<uint64>(-m.size_mod), np);
+            }
+
+        }
+
+        i = j;
+    }
+
+    return;
+}
+
+
+
+
+
 /*
  -------------------
  Inner function to get old position for deletion.
@@ -522,25 +781,25 @@ uint64 HapChrom::deletion_old_pos_(const uint64& deletion_start,
                                     const uint64& deletion_end,
                                     const uint64& mut_i) const {
 
-    if (mutations.new_pos[mut_i] == deletion_start) {
-        return mutations.old_pos[mut_i];
+    if (mutations.new_pos(mut_i) == deletion_start) {
+        return mutations.old_pos(mut_i);
     }
     /*
      This is for when the first mutation starts after the deletion but will be at
      least partially removed by it.
      */
-    if (mutations.new_pos[mut_i] > deletion_start) {
+    if (mutations.new_pos(mut_i) > deletion_start) {
         return deletion_start;
     }
 
     sint64 sm = size_modifier(mut_i);
     // (below can overflow if sm < 0, but that's fine bc it won't be used in that case.)
-    uint64 mut_end = mutations.new_pos[mut_i] + sm;
+    uint64 mut_end = mutations.new_pos(mut_i) + sm;
 
     // This works only for subs and deletions, plus for insertions that aren't overlapping
     if (sm <= 0 || mut_end < deletion_start) {
-        uint64 old_pos = deletion_start - mutations.new_pos[mut_i] +
-            mutations.old_pos[mut_i] - sm;
+        uint64 old_pos = deletion_start - mutations.new_pos(mut_i) +
+            mutations.old_pos(mut_i) - sm;
         return old_pos;
     }
 
@@ -551,8 +810,8 @@ uint64 HapChrom::deletion_old_pos_(const uint64& deletion_start,
      For (1), this value won't be used bc no extra mutation will be added.
      For (2), this is the right value to use for the new mutation.
      */
-    if (deletion_start == mutations.new_pos[mut_i]) {
-        return mutations.old_pos[mut_i];
+    if (deletion_start == mutations.new_pos(mut_i)) {
+        return mutations.old_pos(mut_i);
     }
 
 
@@ -564,7 +823,7 @@ uint64 HapChrom::deletion_old_pos_(const uint64& deletion_start,
      For (1), this value won't be used bc no extra mutation will be added.
      For (2), this is the right value to use for the new mutation.
      */
-    return mutations.old_pos[mut_i] + 1;
+    return mutations.old_pos(mut_i) + 1;
 
 }
 
@@ -587,11 +846,11 @@ void HapChrom::deletion_one_mut_(const uint64& mut_i,
                                  sint64& new_size_mod,
                                  std::vector<uint64>& rm_inds) {
 
-    uint64& mut_pos(mutations.new_pos[mut_i]);
+    uint64 mut_pos = mutations.new_pos(mut_i);
 
     // If it's after (and not next to) the deletion, then adjust the new_pos and finish
     if (mut_pos > (deletion_end + 1)) {
-        mut_pos += full_size_mod;
+        mutations.set_new_pos(mut_i, mut_pos + full_size_mod);
         return;
     }
 
@@ -604,7 +863,7 @@ void HapChrom::deletion_one_mut_(const uint64& mut_i,
     if (sm == 0) {
         // If it's immediately after the deletion, adjust new_pos and finish
         if (mut_pos > deletion_end) {
-            mut_pos += full_size_mod;
+            mutations.set_new_pos(mut_i, mut_pos + full_size_mod);
             return;
         }
         // If it's before the deletion, do nothing
@@ -624,7 +883,7 @@ void HapChrom::deletion_one_mut_(const uint64& mut_i,
 
         // If it's immediately after the deletion, adjust new_pos and finish
         if (mut_pos > deletion_end) {
-            mut_pos += full_size_mod;
+            mutations.set_new_pos(mut_i, mut_pos + full_size_mod);
             return;
         }
 
@@ -656,21 +915,12 @@ void HapChrom::deletion_one_mut_(const uint64& mut_i,
         uint64 erase_ind1 = deletion_end - mut_pos + 1;
         erase_ind1 = std::min(
             erase_ind1,
-            static_cast<uint64>(std::strlen(mutations.nucleos[mut_i]))
+            mutations.nucleos_size(mut_i)
         );
         new_size_mod += (erase_ind1 - erase_ind0);
 
-        /*
-         Re-size nucleotides for this mutation.
-         I'm doing this by making a std::string, resizing, then assinging it back
-         to the `char*` object in `nucleos`
-         */
-        std::string nts(mutations.nucleos[mut_i]);
-        nts.erase(nts.begin() + erase_ind0, nts.begin() + erase_ind1);
-        // delete and re-assign:
-        delete [] mutations.nucleos[mut_i];
-        mutations.nucleos[mut_i] = new char[nts.size() + 1];
-        std::strcpy(mutations.nucleos[mut_i], nts.c_str());
+        // Re-size nucleotides for this mutation:
+        mutations.erase_nucleos(mut_i, erase_ind0, erase_ind1);
 
 
         /*
@@ -680,9 +930,9 @@ void HapChrom::deletion_one_mut_(const uint64& mut_i,
          (3) has a starting position before this insertion
          */
         if (deletion_start < mut_pos && deletion_end < mut_end) {
-            // mut_pos -= (erase_ind1 + erase_ind0);
             mut_pos += (erase_ind1 - erase_ind0);
             mut_pos += full_size_mod;
+            mutations.set_new_pos(mut_i, mut_pos);
         }
 
         return;
@@ -727,7 +977,7 @@ void HapChrom::deletion_one_mut_(const uint64& mut_i,
 
 uint64 HapChrom::get_mut_(const uint64& new_pos) const {
 
-    uint64 mut_i = 0;
+    uint64 mut_i;
 
     if (mutations.empty()) return mutations.size();
 
@@ -737,35 +987,17 @@ uint64 HapChrom::get_mut_(const uint64& new_pos) const {
 
     }
     /*
-     If new_pos is less than the position for the first mutation, we return
-     mutations.size():
-     */
-    if (new_pos < mutations.new_pos.front()) return mutations.size();
-
-    /*
-     If the new_pos is greater than or equal to the position for the last
-     mutation, we return the last Mutation:
-     */
-    if (new_pos >= mutations.new_pos.back()) return mutations.size() - 1;
-
-    /*
-     If not either of the above, then we will first try to guess the approximate
-     position to minimize how many iterations we have to perform.
-     */
-    mut_i = static_cast<double>(mutations.size() * new_pos) /
-        static_cast<double>(chrom_size);
-    /*
-     If the current mutation is not past `new_pos`, iterate until it is.
-     I'm intentionally going past the mutation to make sure we're not getting a deletion
+     The first mutation past `new_pos` is found using binary search (first
+     among blocks of mutations, then within one block).
+     The one before it is the last mutation that's <= `new_pos`.
+     Using the first one past `new_pos` makes sure we're not getting a deletion
      immediately followed by another mutation.
-     (We don't need to check for `mut_i` getting to the last index
-     (`mutations.size() - 1`) because we've already checked for that situation above.)
-     */
-    while (mutations.new_pos[mut_i] <= new_pos) ++mut_i;
-    /*
-     Now move mutation to the proper spot: the last mutation that is <= `new_pos`.
+     If new_pos is less than the position for the first mutation, we return
+     mutations.size().
      */
-    while (mutations.new_pos[mut_i] > new_pos) --mut_i;
+    mut_i = mutations.upper_bound_new(new_pos);
+    if (mut_i == 0) return mutations.size();
+    --mut_i;
 
     return mut_i;
 }
@@ -18,6 +18,9 @@
 #include <string>  // string class
 #include <cstring> // for std::strcpy
 #include <deque>  // deque class
+#include <limits>  // numeric_limits
+#include <algorithm>  // upper_bound, min
+#include <memory>  // shared_ptr, make_shared
 
 #include "jackalope_types.h"  // integer types
 #include "ref_classes.h"  // Ref* classes
@@ -97,95 +100,390 @@ using namespace Rcpp;
 
 
 
-struct AllMutations {
+/*
+ Nucleotide info for one mutation.
+ Substitutions store their nucleotide inline, deletions store nothing, and
+ insertions point to a range inside `MutBlock::pool`.
+ This way, no mutation requires its own heap allocation.
+ */
+struct MutNucleos {
+    uint64 start;  // start of sequence in `pool` (insertions only)
+    uint32 size;   // # nucleotides (0 for deletions, 1 for substitutions)
+    char nt;       // nucleotide (substitutions only)
+
+    MutNucleos() : start(0), size(0), nt('\0') {}
+    MutNucleos(const char& nt_) : start(0), size(1), nt(nt_) {}
+    MutNucleos(const uint64& start_, const uint32& size_)
+        : start(start_), size(size_), nt('\0') {}
+};
+
+
+namespace jlp {
+    /*
+     Mutation blocks are split in half once they grow past this many mutations.
+     Indels have to adjust positions within one block plus one offset per block,
+     so this keeps both of those small.
+     */
+    const uint64 mut_block_max = 2048;
+}
+
+
+/*
+ A contiguous block of mutations, stored as a structure of arrays.
+ Values in `new_pos` are relative to the block's offset in `AllMutations`.
+ Sequences for insertions are stored contiguously in `pool`.
+ When insertions are edited or removed, their old sequences in `pool` become
+ garbage, which is cleared out once it makes up most of `pool`.
+ */
+struct MutBlock {
+
+    std::vector<uint64> old_pos;
+    std::vector<uint64> new_pos;
+    std::vector<MutNucleos> nucleos;
+    std::string pool;
+    uint64 pool_garbage;
+
+    MutBlock() : old_pos(), new_pos(), nucleos(), pool(), pool_garbage(0) {}
+
+    inline uint64 size() const noexcept {
+        return old_pos.size();
+    }
 
-    std::deque<uint64> old_pos;
-    std::deque<uint64> new_pos;
-    std::deque<char*> nucleos;
+    inline const char* nucleos_data(const uint64& j) const {
+        const MutNucleos& mn(nucleos[j]);
+        if (mn.size == 0) return nullptr;
+        if (mn.size == 1) return &mn.nt;
+        return pool.data() + mn.start;
+    }
+    inline char get_nucleo(const uint64& j, const uint64& nt_ind) const {
+        const MutNucleos& mn(nucleos[j]);
+        if (mn.size == 1) return mn.nt;
+        return pool[mn.start + nt_ind];
+    }
+    inline void set_nucleo(const uint64& j, const uint64& nt_ind, const char& nt) {
+        MutNucleos& mn(nucleos[j]);
+        if (mn.size == 1) {
+            mn.nt = nt;
+        } else pool[mn.start + nt_ind] = nt;
+        return;
+    }
 
-    AllMutations() : old_pos(), new_pos(), nucleos() {}
+    // Make nucleotide info from a C string (`nullptr` or size 0 for deletions)
+    MutNucleos make_nucleos(const char* nts, const uint64& nts_size) {
+        if (nts == nullptr || nts_size == 0) return MutNucleos();
+        if (nts_size == 1) return MutNucleos(nts[0]);
+        if (nts_size > std::numeric_limits<uint32>::max()) {
+            stop("Insertion too large to be stored in AllMutations.");
+        }
+        // Clear out garbage before it gets too big:
+        if (pool_garbage > 4096 && pool_garbage > (pool.size() / 2)) compact_pool();
+        MutNucleos mn(pool.size(), nts_size);
+        pool.append(nts, nts_size);
+        return mn;
+    }
+
+    // Mark a mutation's sequence in `pool` as no longer used
+    inline void discard(const MutNucleos& mn) {
+        if (mn.size > 1) pool_garbage += mn.size;
+        return;
+    }
 
-    AllMutations(const AllMutations& other)
-        : old_pos(other.old_pos),
-          new_pos(other.new_pos),
-          nucleos(other.nucleos.size(), nullptr) {
-        for (uint64 i = 0; i < nucleos.size(); i++) {
-            fill_one_nucleos__(other.nucleos[i], &nucleos[i]);
+    void insert(const uint64& j,
+                const uint64& op,
+                const uint64& np,
+                const char* nts,
+                const uint64& nts_size) {
+        old_pos.insert(old_pos.begin() + j, op);
+        new_pos.insert(new_pos.begin() + j, np);
+        nucleos.insert(nucleos.begin() + j, make_nucleos(nts, nts_size));
+        return;
+    }
+
+    // Remove from `j1` to `j2 - 1`
+    void erase(const uint64& j1, const uint64& j2) {
+        old_pos.erase(old_pos.begin() + j1, old_pos.begin() + j2);
+        new_pos.erase(new_pos.begin() + j1, new_pos.begin() + j2);
+        for (uint64 j = j1; j < j2; j++) discard(nucleos[j]);
+        nucleos.erase(nucleos.begin() + j1, nucleos.begin() + j2);
+        if (nucleos.empty()) {
+            std::string().swap(pool);
+            pool_garbage = 0;
         }
+        return;
     }
-    AllMutations& operator=(const AllMutations& other) {
 
-        old_pos = other.old_pos;
-        new_pos = other.new_pos;
-        for (uint64 i = 0; i < nucleos.size(); i++) delete [] nucleos[i];
-        nucleos = std::deque<char*>(other.nucleos.size(), nullptr);
-        for (uint64 i = 0; i < nucleos.size(); i++) {
-            fill_one_nucleos__(other.nucleos[i], &nucleos[i]);
+    // Move the second half of this block to a new, empty block
+    void split(MutBlock& other) {
+        uint64 half = size() / 2;
+        other.old_pos.assign(old_pos.begin() + half, old_pos.end());
+        other.new_pos.assign(new_pos.begin() + half, new_pos.end());
+        other.nucleos.reserve(size() - half);
+        for (uint64 j = half; j < size(); j++) {
+            other.nucleos.push_back(other.make_nucleos(nucleos_data(j),
+                                                       nucleos[j].size));
+            discard(nucleos[j]);
         }
-        return *this;
+        old_pos.resize(half);
+        new_pos.resize(half);
+        nucleos.resize(half);
+        return;
     }
 
-    ~AllMutations() {
-        for (uint64 i = 0; i < nucleos.size(); i++) {
-            delete [] nucleos[i];
+    // Remove unused sequences from `pool`
+    void compact_pool() {
+        std::string new_pool;
+        new_pool.reserve(pool.size() - pool_garbage);
+        for (MutNucleos& mn : nucleos) {
+            if (mn.size > 1) {
+                uint64 new_start = new_pool.size();
+                new_pool.append(pool, mn.start, mn.size);
+                mn.start = new_start;
+            }
         }
+        pool.swap(new_pool);
+        pool_garbage = 0;
+        return;
     }
 
+};
+
+
+/*
+ All mutations for one haplotype chromosome.
+
+ Mutations are stored in order inside a vector of `MutBlock`s, and are accessed
+ using their overall index (i.e., across all blocks).
+ Each block has an offset (in `offsets`) that's added to its stored new positions,
+ so an indel only has to change positions inside one block, plus the offsets of
+ all blocks after it.
+ (Offsets are unsigned and rely on wrap-around arithmetic, so they can
+ effectively be negative.)
+ Blocks are held by shared pointers and are copied only when they're changed,
+ so copying an `AllMutations` object (or appending one to another) doesn't
+ duplicate mutations that two haplotypes have in common.
+ Offsets are never shared, so shifting positions never requires copying a block.
+ */
+class AllMutations {
+
+public:
+
+    AllMutations() : blocks(), offsets(), starts(), n_muts(0) {}
+
 
     inline size_t size() const noexcept {
-        return old_pos.size();
+        return n_muts;
     }
 
     inline bool empty() const noexcept {
-        return old_pos.empty();
+        return n_muts == 0;
     }
 
     inline void clear() {
+        blocks.clear();
+        offsets.clear();
+        starts.clear();
+        n_muts = 0;
+        return;
+    }
+
+    /*
+     Positions for one mutation
+     */
+    inline uint64 old_pos(const uint64& ind) const {
+        uint64 b, j;
+        locate__(ind, b, j);
+        return blocks[b]->old_pos[j];
+    }
+    inline uint64 new_pos(const uint64& ind) const {
+        uint64 b, j;
+        locate__(ind, b, j);
+        return blocks[b]->new_pos[j] + offsets[b];
+    }
+    // Both of the above, using one lookup
+    inline void positions(const uint64& ind, uint64& op, uint64& np) const {
+        uint64 b, j;
+        locate__(ind, b, j);
+        op = blocks[b]->old_pos[j];
+        np = blocks[b]->new_pos[j] + offsets[b];
+        return;
+    }
+    inline void set_old_pos(const uint64& ind, const uint64& op) {
+        uint64 b, j;
+        locate__(ind, b, j);
+        own__(b).old_pos[j] = op;
+        return;
+    }
+    inline void set_new_pos(const uint64& ind, const uint64& np) {
+        uint64 b, j;
+        locate__(ind, b, j);
+        own__(b).new_pos[j] = np - offsets[b];
+        return;
+    }
 
-        if (old_pos.size() == 0) return;
+    /*
+     Add `modifier` to the new positions for all mutations after AND INCLUDING
+     the given index.
+     */
+    inline void shift_new_pos(const uint64& ind, const sint64& modifier) {
+        if (ind >= n_muts) return;
+        uint64 b, j;
+        locate__(ind, b, j);
+        std::vector<uint64>& np(own__(b).new_pos);
+        for (; j < np.size(); j++) np[j] += modifier;
+        for (++b; b < offsets.size(); b++) offsets[b] += modifier;
+        return;
+    }
 
-        old_pos.clear();
-        new_pos.clear();
-        nucleos.clear();
+    /*
+     Index of the first mutation with a new position >= `np`, or `size()` if
+     there isn't one.
+     */
+    uint64 lower_bound_new(const uint64& np) const {
+        // First block whose first mutation is >= `np`:
+        uint64 lo = 0, hi = blocks.size();
+        while (lo < hi) {
+            uint64 mid = (lo + hi) / 2;
+            if ((blocks[mid]->new_pos.front() + offsets[mid]) < np) {
+                lo = mid + 1;
+            } else hi = mid;
+        }
+        if (lo == 0) return 0;
+        // The answer is either in the previous block or at the start of this one:
+        uint64 b = lo - 1;
+        const uint64& off(offsets[b]);
+        const std::vector<uint64>& bnp(blocks[b]->new_pos);
+        uint64 j = std::lower_bound(bnp.begin(), bnp.end(), np,
+                                    [&off](const uint64& x, const uint64& y) {
+                                        return (x + off) < y;
+                                    }) - bnp.begin();
+        return starts[b] + j;
+    }
+    /*
+     Index of the first mutation with a new position > `np`, or `size()` if
+     there isn't one.
+     */
+    uint64 upper_bound_new(const uint64& np) const {
+        // First block whose first mutation is > `np`:
+        uint64 lo = 0, hi = blocks.size();
+        while (lo < hi) {
+            uint64 mid = (lo + hi) / 2;
+            if ((blocks[mid]->new_pos.front() + offsets[mid]) <= np) {
+                lo = mid + 1;
+            } else hi = mid;
+        }
+        if (lo == 0) return 0;
+        // The answer is either in the previous block or at the start of this one:
+        uint64 b = lo - 1;
+        const uint64& off(offsets[b]);
+        const std::vector<uint64>& bnp(blocks[b]->new_pos);
+        uint64 j = std::upper_bound(bnp.begin(), bnp.end(), np,
+                                    [&off](const uint64& x, const uint64& y) {
+                                        return x < (y + off);
+                                    }) - bnp.begin();
+        return starts[b] + j;
+    }
 
+
+    /*
+     Access nucleotide info for one mutation.
+     `nucleos_data` returns `nullptr` for deletions.
+     */
+    inline uint64 nucleos_size(const uint64& ind) const {
+        uint64 b, j;
+        locate__(ind, b, j);
+        return blocks[b]->nucleos[j].size;
+    }
+    inline const char* nucleos_data(const uint64& ind) const {
+        uint64 b, j;
+        locate__(ind, b, j);
+        return blocks[b]->nucleos_data(j);
+    }
+    inline char get_nucleo(const uint64& ind, const uint64& nt_ind) const {
+        uint64 b, j;
+        locate__(ind, b, j);
+        return blocks[b]->get_nucleo(j, nt_ind);
+    }
+    inline std::string get_nucleos(const uint64& ind) const {
+        uint64 b, j;
+        locate__(ind, b, j);
+        const MutBlock& block(*blocks[b]);
+        if (block.nucleos[j].size == 0) return "";
+        return std::string(block.nucleos_data(j), block.nucleos[j].size);
+    }
+
+    // Change one nucleotide for one mutation
+    inline void set_nucleo(const uint64& ind, const uint64& nt_ind, const char& nt) {
+        uint64 b, j;
+        locate__(ind, b, j);
+        own__(b).set_nucleo(j, nt_ind, nt);
         return;
     }
+    // Replace all nucleotides for one mutation
+    inline void set_nucleos(const uint64& ind, const std::string& nts) {
+        uint64 b, j;
+        locate__(ind, b, j);
+        MutBlock& block(own__(b));
+        block.discard(block.nucleos[j]);
+        block.nucleos[j] = block.make_nucleos(nts.c_str(), nts.size());
+        return;
+    }
+    // Remove nucleotides (from `nt_ind0` to `nt_ind1 - 1`) for one mutation
+    inline void erase_nucleos(const uint64& ind,
+                              const uint64& nt_ind0,
+                              const uint64& nt_ind1) {
+        uint64 b, j;
+        locate__(ind, b, j);
+        MutBlock& block(own__(b));
+        MutNucleos& mn(block.nucleos[j]);
+        uint64 n_erase = nt_ind1 - nt_ind0;
+        if (n_erase == 0) return;
+        if (mn.size == 1) {
+            mn.size = 0;
+            return;
+        }
+        char* nts = &block.pool[mn.start];
+        std::memmove(nts + nt_ind0, nts + nt_ind1, mn.size - nt_ind1);
+        mn.size -= n_erase;
+        block.pool_garbage += n_erase;
+        // Single nucleotides are always stored inline:
+        if (mn.size == 1) {
+            mn.nt = nts[0];
+            block.pool_garbage++;
+        }
+        return;
+    }
+
     // Add to front
     inline void push_front(const uint64& op,
                            const uint64& np,
                            const char* nts) {
-        old_pos.push_front(op);
-        new_pos.push_front(np);
-        nucleos.push_front(nullptr);
-        fill_one_nucleos__(nts, &nucleos.front());
+        insert(0, op, np, nts);
         return;
     }
     inline void push_front(const uint64& op,
                            const uint64& np,
                            const char& nt) {
-        old_pos.push_front(op);
-        new_pos.push_front(np);
-        nucleos.push_front(nullptr);
-        fill_one_nucleos__(nt, &nucleos.front());
+        insert(0, op, np, nt);
         return;
     }
     // Add to back
     inline void push_back(const uint64& op,
                           const uint64& np,
                           const char* nts) {
-        old_pos.push_back(op);
-        new_pos.push_back(np);
-        nucleos.push_back(nullptr);
-        fill_one_nucleos__(nts, &nucleos.back());
+        insert(n_muts, op, np, nts);
         return;
     }
     inline void push_back(const uint64& op,
                           const uint64& np,
                           const char& nt) {
-        old_pos.push_back(op);
-        new_pos.push_back(np);
-        nucleos.push_back(nullptr);
-        fill_one_nucleos__(nt, &nucleos.back());
+        insert(n_muts, op, np, nt);
+        return;
+    }
+    inline void push_back(const uint64& op,
+                          const uint64& np,
+                          const char* nts,
+                          const uint64& nts_size) {
+        insert(n_muts, op, np, nts, nts_size);
         return;
     }
     // Add to middle
@@ -193,65 +491,164 @@ struct AllMutations {
                        const uint64& op,
                        const uint64& np,
                        const char* nts) {
-
-        old_pos.insert(old_pos.begin() + ind, op);
-        new_pos.insert(new_pos.begin() + ind, np);
-        nucleos.insert(nucleos.begin() + ind, nullptr);
-        fill_one_nucleos__(nts, &nucleos[ind]);
+        uint64 nts_size = (nts == nullptr) ? 0 : std::strlen(nts);
+        insert(ind, op, np, nts, nts_size);
         return;
     }
     inline void insert(const uint64& ind,
                        const uint64& op,
                        const uint64& np,
                        const char& nt) {
+        insert(ind, op, np, &nt, 1);
+        return;
+    }
+    void insert(const uint64& ind,
+                const uint64& op,
+                const uint64& np,
+                const char* nts,
+                const uint64& nts_size) {
+
+        /*
+         Adding to the back of a full block (or to an empty object) starts a new
+         block, so mutations added in order fill blocks without splitting them.
+         */
+        if (blocks.empty() ||
+            (ind == n_muts && blocks.back()->size() >= jlp::mut_block_max)) {
+            blocks.push_back(std::make_shared<MutBlock>());
+            offsets.push_back(blocks.size() > 1 ? offsets[blocks.size() - 2] : 0);
+            starts.push_back(n_muts);
+        }
+
+        uint64 b, j;
+        if (ind == n_muts) {
+            b = blocks.size() - 1;
+            j = blocks[b]->size();
+        } else locate__(ind, b, j);
+
+        own__(b).insert(j, op, np - offsets[b], nts, nts_size);
+        for (uint64 k = b + 1; k < starts.size(); k++) starts[k]++;
+        n_muts++;
+
+        if (blocks[b]->size() > jlp::mut_block_max) split__(b);
+
+        return;
+    }
+
+    /*
+     Add mutations in `other` from index `ind` to `ind_end - 1`, adding `shift`
+     to all of their new positions.
+     Blocks that are entirely copied are shared with `other` rather than
+     duplicated.
+     Mutations in `other` must all come after the ones in this object.
+     */
+    void append(const AllMutations& other,
+                const uint64& ind,
+                const uint64& ind_end,
+                const sint64& shift) {
+
+        const uint64 last = std::min(ind_end, static_cast<uint64>(other.n_muts));
+        if (ind >= last) return;
+
+        uint64 b, j;
+        other.locate__(ind, b, j);
+
+        for (uint64 i = ind; i < last; b++, j = 0) {
+            const MutBlock& block(*other.blocks[b]);
+            uint64 n = std::min(block.size() - j, last - i);
+            if (n == block.size()) {
+                // Whole block is shared:
+                blocks.push_back(other.blocks[b]);
+                offsets.push_back(other.offsets[b] + shift);
+                starts.push_back(n_muts);
+                n_muts += n;
+            } else {
+                // Partially used block gets copied:
+                for (uint64 k = j; k < (j + n); k++) {
+                    insert(n_muts, block.old_pos[k],
+                           block.new_pos[k] + other.offsets[b] + shift,
+                           block.nucleos_data(k), block.nucleos[k].size);
+                }
+            }
+            i += n;
+        }
 
-        old_pos.insert(old_pos.begin() + ind, op);
-        new_pos.insert(new_pos.begin() + ind, np);
-        nucleos.insert(nucleos.begin() + ind, nullptr);
-        fill_one_nucleos__(nt, &nucleos[ind]);
         return;
     }
+    // Same as above, but to the end of `other`
+    inline void append(const AllMutations& other,
+                       const uint64& ind,
+                       const sint64& shift) {
+        append(other, ind, other.n_muts, shift);
+        return;
+    }
+
     // Remove from position
     inline void erase(const uint64& ind) {
-
-        old_pos.erase(old_pos.begin() + ind);
-        new_pos.erase(new_pos.begin() + ind);
-        delete [] nucleos[ind];
-        nucleos.erase(nucleos.begin() + ind);
+        erase(ind, ind + 1);
         return;
     }
 
-    // Remove between positions
-    inline void erase(const uint64& ind1, const uint64& ind2) {
+    // Remove between positions (`ind2` not inclusive)
+    void erase(const uint64& ind1, const uint64& ind2) {
+
+        uint64 n_left = ind2 - ind1;
+
+        while (n_left > 0) {
+            uint64 b, j;
+            locate__(ind1, b, j);
+            uint64 n_rm = std::min(n_left, blocks[b]->size() - j);
+            for (uint64 k = b + 1; k < starts.size(); k++) starts[k] -= n_rm;
+            n_muts -= n_rm;
+            n_left -= n_rm;
+            // (No need to copy a shared block if it's all being removed)
+            if (n_rm == blocks[b]->size()) {
+                blocks.erase(blocks.begin() + b);
+                offsets.erase(offsets.begin() + b);
+                starts.erase(starts.begin() + b);
+            } else own__(b).erase(j, j + n_rm);
+        }
 
-        old_pos.erase(old_pos.begin() + ind1, old_pos.begin() + ind2);
-        new_pos.erase(new_pos.begin() + ind1, new_pos.begin() + ind2);
-        for (uint64 ind = ind1; ind < ind2; ind++) delete [] nucleos[ind];
-        nucleos.erase(nucleos.begin() + ind1, nucleos.begin() + ind2);
         return;
     }
 
 
 private:
 
+    std::vector<std::shared_ptr<MutBlock>> blocks;
+    std::vector<uint64> offsets;  // added to `new_pos` for each block
+    std::vector<uint64> starts;  // overall index for the first mutation in each block
+    uint64 n_muts;
 
-    // Fill one `char *` in `nucleos` with values from a `const char *` object
-    inline void fill_one_nucleos__(const char* nts, char** one_nucleos) {
-        if (nts != nullptr) {
-            size_t nts_size = std::strlen(nts);
-            *one_nucleos = new char[nts_size + 1];
-            for (size_t i = 0; i < nts_size; i++) {
-                (*one_nucleos)[i] = nts[i];
-            }
-            (*one_nucleos)[nts_size] = '\0';
+    /*
+     Block `b`, ready to be changed.
+     Blocks can be shared among objects (e.g., between haplotypes that
+     share ancestry), so a shared block is copied before it's changed.
+     */
+    inline MutBlock& own__(const uint64& b) {
+        if (blocks[b].use_count() > 1) {
+            blocks[b] = std::make_shared<MutBlock>(*blocks[b]);
         }
+        return *blocks[b];
+    }
+
+    // Find the block (`b`) and index within that block (`j`) for a mutation index
+    inline void locate__(const uint64& ind, uint64& b, uint64& j) const {
+#ifdef __JACKALOPE_DEBUG
+        if (ind >= n_muts) stop("ind >= n_muts in AllMutations::locate__");
+#endif
+        b = std::upper_bound(starts.begin(), starts.end(), ind) - starts.begin() - 1;
+        j = ind - starts[b];
         return;
     }
-    // Same but for a reference to one character
-    inline void fill_one_nucleos__(const char& nt, char** one_nucleos) {
-        *one_nucleos = new char[2];
-        (*one_nucleos)[0] = nt;
-        (*one_nucleos)[1] = '\0';
+
+    // Split block `b` into two
+    void split__(const uint64& b) {
+        std::shared_ptr<MutBlock> new_block = std::make_shared<MutBlock>();
+        own__(b).split(*new_block);
+        uint64 new_start = starts[b] + blocks[b]->size();
+        blocks.insert(blocks.begin() + b + 1, new_block);
+        offsets.insert(offsets.begin() + b + 1, offsets[b]);
+        starts.insert(starts.begin() + b + 1, new_start);
         return;
     }
 
@@ -278,6 +675,46 @@ private:
 class SubMutator;
 
 
+/*
+ One insertion or deletion for `HapChrom::add_indels`.
+ Indels in one batch are sorted so that positions never decrease, and
+ each position is where the indel goes after all indels before it in the batch
+ have been added.
+ Insertions go after `pos`, and their sequences are in a string
+ shared by the whole batch.
+ */
+struct Indel {
+    uint64 pos;
+    uint64 size;
+    uint64 seq_start;  // start of inserted sequence (insertions only)
+    bool insertion;
+
+    Indel() : pos(0), size(0), seq_start(0), insertion(false) {}
+    Indel(const uint64& pos_, const uint64& size_, const uint64& seq_start_,
+          const bool& insertion_)
+        : pos(pos_), size(size_), seq_start(seq_start_), insertion(insertion_) {}
+};
+
+
+/*
+ One mutation for `HapChrom::add_ref_mutations`, at a position on the reference.
+ `size_mod` is 0 for substitutions, > 0 for insertions, and < 0 for deletions.
+ Nucleotides for substitutions and insertions are in a string shared by the
+ whole batch, starting at `seq_start`.
+ As in `AllMutations`, an insertion's nucleotides start with the one at `pos`,
+ so there are `size_mod + 1` of them.
+ */
+struct RefMutation {
+    uint64 pos;
+    sint64 size_mod;
+    uint64 seq_start;
+
+    RefMutation() : pos(0), size_mod(0), seq_start(0) {}
+    RefMutation(const uint64& pos_, const sint64& size_mod_, const uint64& seq_start_)
+        : pos(pos_), size_mod(size_mod_), seq_start(seq_start_) {}
+};
+
+
 /*
  =========================================
  One chromosome from one haplotype haploid genome
@@ -315,8 +752,8 @@ public:
 
         sint64 size_mod;
 
-        if (ind < (mutations.new_pos.size() - 1)) {
-            size_mod = mutations.new_pos[ind+1] - mutations.old_pos[ind+1];
+        if (ind < (mutations.size() - 1)) {
+            size_mod = mutations.new_pos(ind+1) - mutations.old_pos(ind+1);
 #ifdef __JACKALOPE_DEBUG
         } else if (ind == (mutations.size() - 1)) {
             size_mod = chrom_size - ref_chrom->size();
@@ -327,7 +764,7 @@ public:
         }
 #endif
 
-        size_mod += static_cast<sint64>(mutations.old_pos[ind] - mutations.new_pos[ind]);
+        size_mod += static_cast<sint64>(mutations.old_pos(ind) - mutations.new_pos(ind));
 
         return size_mod;
 }
@@ -335,6 +772,9 @@ public:
     // Add existing mutation information in another `HapChrom` to this one,
     // adding to the back of `mutations`, with a starting mutation index
     sint64 add_to_back(const HapChrom& other, const uint64& mut_i);
+    // Same as above, but only up to mutation index `mut_end - 1`
+    sint64 add_to_back(const HapChrom& other, const uint64& mut_i,
+                       const uint64& mut_end);
 
 
     /*
@@ -345,9 +785,7 @@ public:
      */
     inline void calc_positions(uint64 mut_i, const sint64& modifier) {
         // Updating individual Mutation objects
-        for (; mut_i < mutations.size(); ++mut_i) {
-            mutations.new_pos[mut_i] += modifier;
-        }
+        mutations.shift_new_pos(mut_i, modifier);
         // Updating full chromosome size
         chrom_size += modifier;
 
@@ -383,6 +821,18 @@ public:
     void add_deletion(const uint64& size_, const uint64& new_pos_);
     void add_insertion(const std::string& nucleos_, const uint64& new_pos_);
     void add_substitution(const char& nucleo, const uint64& new_pos_);
+    // Add many indels at once (see `Indel` class above)
+    void add_indels(const std::vector<Indel>& indels, const std::string& seqs);
+    /*
+     Change positions `begin` to `begin + seq.size() - 1` to match `seq`,
+     where `seq` has the same size as that region.
+     Indels are kept as they are, so this only changes substitutions and the
+     nucleotides inside insertions.
+     */
+    void set_region(const std::string& seq, const uint64& begin);
+    // Add many mutations at positions on the reference (see `RefMutation` class above)
+    void add_ref_mutations(const std::vector<RefMutation>& muts,
+                           const std::string& seqs);
 
 
     /*
@@ -427,6 +877,20 @@ private:
 
 
 
+    /*
+     ------------------
+     Internal function to copy positions `start` to `start + n - 1` on the
+     haplotype chromosome to `out`, using runs of nucleotides rather than
+     single characters.
+     ------------------
+     */
+    void fill_range_(char* out,
+                     const uint64& start,
+                     const uint64& n,
+                     uint64& mut_i) const;
+
+
+
     /*
      ------------------
      Internal function for finding character of either mutation or reference
@@ -439,17 +903,18 @@ private:
     inline char get_char_(const uint64& new_pos,
                           const uint64& mut_i) const {
         char out;
-        uint64 ind = new_pos - mutations.new_pos[mut_i];
-        if (static_cast<sint64>(ind) > size_modifier(mut_i)) {
-            ind += (mutations.old_pos[mut_i] - size_modifier(mut_i));
+        uint64 ind = new_pos - mutations.new_pos(mut_i);
+        const sint64 sm = size_modifier(mut_i);
+        if (static_cast<sint64>(ind) > sm) {
+            ind += (mutations.old_pos(mut_i) - sm);
             out = (*ref_chrom)[ind];
         } else {
-            if (mutations.nucleos[mut_i] == nullptr) {
-                std::string err_msg = "mutations.nucleos[mut_i] == nullptr at ";
+            if (mutations.nucleos_size(mut_i) == 0) {
+                std::string err_msg = "mutations.nucleos_size(mut_i) == 0 at ";
                 err_msg += std::to_string(mut_i);
                 stop(err_msg.c_str());
             }
-            out = mutations.nucleos[mut_i][ind];
+            out = mutations.get_nucleo(mut_i, ind);
         }
         return out;
     }
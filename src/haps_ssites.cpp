@@ -6,6 +6,8 @@
 #include <pcg/pcg_random.hpp> // pcg prng
 #include <vector>  // vector class
 #include <string>  // string class
+#include <algorithm>  // stable_sort, min, min_element
+#include <utility>  // pair
 #include <progress.hpp>  // for the progress bar
 #ifdef _OPENMP
 #include <omp.h>  // omp
@@ -17,7 +19,7 @@
 #include "hap_classes.h"  // Hap* classes
 #include "pcg.h"  // pcg seeding
 #include "alias_sampler.h"  // alias method of sampling
-#include "util.h"  // thread_check
+#include "util.h"  // thread_check, cost_order
 
 using namespace Rcpp;
 
@@ -55,57 +57,106 @@ MutationTypeSampler make_type_sampler(const arma::mat& Q,
 
 
 /*
- Add mutations at segregating sites for one chromosome from coalescent simulation output.
+ Mutations at all segregating sites for one chromosome, sorted by position.
+ `rows` has the row in the segregating-sites matrix for each mutation, which is used
+ to find the haplotypes that have it.
 */
-void add_one_chrom_ssites(HapSet& hap_set,
-                        const RefGenome& ref_genome,
-                        const uint64& chrom_i,
-                        const arma::mat& ss_i,
-                        MutationTypeSampler& type_sampler,
-                        AliasStringSampler<std::string>& insert_sampler,
-                        pcg64& eng) {
-
-    uint64 pos;
-    std::string nts; // <-- for insertions
-    /*
-     Going from back so we don't have to update positions constantly, and so we can
-     use the char from the reference genome directly.
-     */
-    for (uint64 k = 0; k < ss_i.n_rows; k++) {
-        uint64 i = ss_i.n_rows - 1 - k;
-        pos = ss_i(i, 0);
-        const char& c(ref_genome[chrom_i][pos]);
-        MutationInfo mut = type_sampler.sample(c, eng);
-        if (mut.nucleo == 'X') continue; // This happens when `c` isn't T, C, A, or G
-        if (mut.length == 0) {
-            for (uint64 j = 1; j < ss_i.n_cols; j++) {
-                if (ss_i(i,j) == 1) {
-                    hap_set[j-1][chrom_i].add_substitution(mut.nucleo, pos);
-                }
-            }
-        } else if (mut.length > 0) {
-            nts.resize(mut.length);  // resize nts on insertion len
-            insert_sampler.sample(nts, eng);  // fill w/ random nucleotides
-            for (uint64 j = 1; j < ss_i.n_cols; j++) {
-                if (ss_i(i,j) == 1) {
-                    hap_set[j-1][chrom_i].add_insertion(nts, pos);
-                }
-            }
-        } else {
-            sint64 pos_ = static_cast<sint64>(pos);
-            sint64 size_ = static_cast<sint64>(hap_set.min_size(chrom_i));
-            if (pos_ - mut.length > size_) {
-                mut.length = static_cast<sint64>(pos_-size_);
+struct SsitesMuts {
+    std::vector<RefMutation> muts;
+    std::vector<uint64> rows;
+    std::string seqs;
+};
+
+
+/*
+ Make mutations at segregating sites for one chromosome from coalescent simulation
+ output.
+ Mutations are sampled from the back so the char from the reference genome can be
+ used directly, and deletions at the end of a chromosome are cut using sizes
+ that are tracked for each haplotype instead of being read from the HapSet.
+*/
+void make_one_chrom_ssites(SsitesMuts& out,
+                           const RefChrom& ref_chrom,
+                           const arma::mat& ss_i,
+                           MutationTypeSampler& type_sampler,
+                           AliasStringSampler<std::string>& insert_sampler,
+                           pcg64& eng) {
+
+    const uint64 n_sites = ss_i.n_rows;
+    const uint64 n_haps = ss_i.n_cols - 1;
+
+    // Sorting by position in case they aren't already:
+    std::vector<uint64> order(n_sites);
+    for (uint64 i = 0; i < n_sites; i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&ss_i](const uint64& a, const uint64& b) {
+                         return ss_i(a, 0) < ss_i(b, 0);
+                     });
+
+    // Sampling mutation types in the same order as before (from the back):
+    std::vector<MutationInfo> infos(n_sites);
+    std::vector<std::string> ins_nts(n_sites);
+    for (uint64 k = 0; k < n_sites; k++) {
+        uint64 i = n_sites - 1 - k;
+        uint64 pos = ss_i(i, 0);
+        infos[i] = type_sampler.sample(ref_chrom[pos], eng);
+        // `nucleo` is 'X' when the reference char isn't T, C, A, or G
+        if (infos[i].nucleo != 'X' && infos[i].length > 0) {
+            ins_nts[i].resize(infos[i].length);  // resize on insertion len
+            insert_sampler.sample(ins_nts[i], eng);  // fill w/ random nucleotides
+        }
+    }
+
+    // Cutting deletions from the back, like when they were added one by one:
+    std::vector<uint64> sizes(n_haps, ref_chrom.size());
+    for (uint64 k = 0; k < n_sites; k++) {
+        uint64 i = order[n_sites - 1 - k];
+        MutationInfo& mut(infos[i]);
+        if (mut.nucleo == 'X' || mut.length == 0) continue;
+        if (mut.length > 0) {
+            for (uint64 j = 0; j < n_haps; j++) {
+                if (ss_i(i, j+1) == 1) sizes[j] += mut.length;
             }
-            uint64 del_size = std::abs(mut.length);
-            for (uint64 j = 1; j < ss_i.n_cols; j++) {
-                if (ss_i(i,j) == 1) {
-                    hap_set[j-1][chrom_i].add_deletion(del_size, pos);
-                }
+            continue;
+        }
+        uint64 pos = ss_i(i, 0);
+        sint64 pos_ = static_cast<sint64>(pos);
+        sint64 size_ = static_cast<sint64>(*std::min_element(sizes.begin(),
+                                                             sizes.end()));
+        if (pos_ - mut.length > size_) {
+            mut.length = static_cast<sint64>(pos_-size_);
+        }
+        uint64 del_size = std::abs(mut.length);
+        if (del_size == 0) {
+            mut.nucleo = 'X';  // nothing to delete
+            continue;
+        }
+        for (uint64 j = 0; j < n_haps; j++) {
+            if (ss_i(i, j+1) == 1 && pos < sizes[j]) {
+                sizes[j] -= std::min(del_size, sizes[j] - pos);
             }
         }
     }
 
+    out.muts.clear();
+    out.rows.clear();
+    out.seqs.clear();
+    out.muts.reserve(n_sites);
+    out.rows.reserve(n_sites);
+    for (const uint64& i : order) {
+        const MutationInfo& mut(infos[i]);
+        if (mut.nucleo == 'X') continue;
+        uint64 pos = ss_i(i, 0);
+        out.muts.push_back(RefMutation(pos, mut.length, out.seqs.size()));
+        out.rows.push_back(i);
+        if (mut.length == 0) {
+            out.seqs.push_back(mut.nucleo);
+        } else if (mut.length > 0) {
+            out.seqs.push_back(ref_chrom[pos]);
+            out.seqs += ins_nts[i];
+        }
+    }
+
     return;
 }
 
@@ -138,11 +189,33 @@ SEXP add_ssites_cpp(SEXP& ref_genome_ptr,
     const uint64 n_chroms = ref_genome->size();
     const uint64 total_chrom = ref_genome->total_size;
 
-    Progress prog_bar(total_chrom, show_progress);
+    Progress prog_bar(total_chrom * n_haps, show_progress);
     std::vector<int> status_codes(n_threads, 0);
 
-    // Generate seeds for random number generators (1 RNG per thread)
-    const std::vector<std::vector<uint64>> seeds = mt_seeds(n_threads);
+    // Mutations for each chromosome, which are then added to each haplotype:
+    std::vector<SsitesMuts> chrom_muts(n_chroms);
+
+    /*
+     Tasks for adding mutations are chromosome and haplotype indices,
+     done from most to least expensive.
+     */
+    std::vector<uint64> chrom_costs(n_chroms);
+    std::vector<std::pair<uint64,uint64>> tasks;
+    std::vector<uint64> task_costs;
+    tasks.reserve(n_chroms * n_haps);
+    task_costs.reserve(n_chroms * n_haps);
+    for (uint64 i = 0; i < n_chroms; i++) {
+        chrom_costs[i] = seg_sites[i].n_rows;
+        for (uint64 j = 0; j < n_haps; j++) {
+            tasks.push_back(std::make_pair(i, j));
+            task_costs.push_back(seg_sites[i].n_rows);
+        }
+    }
+    const std::vector<uint64> chrom_order = cost_order(chrom_costs);
+    const std::vector<uint64> task_order = cost_order(task_costs);
+
+    // RNG streams (1 per chromosome, so output doesn't depend on # threads)
+    const RngStreams streams;
 
 #ifdef _OPENMP
 #pragma omp parallel default(shared) num_threads(n_threads) if (n_threads > 1)
@@ -154,29 +227,54 @@ SEXP add_ssites_cpp(SEXP& ref_genome_ptr,
                                                  deletion_rates);
     AliasStringSampler<std::string> insert("TCAG", pi_tcag);
 
-    std::vector<uint64> active_seeds;
+    std::vector<RefMutation> batch;
 
-    // Write the active seed per thread or just write one of the seeds.
 #ifdef _OPENMP
     uint64 active_thread = omp_get_thread_num();
 #else
     uint64 active_thread = 0;
 #endif
     int& status_code(status_codes[active_thread]);
-    active_seeds = seeds[active_thread];
 
-    pcg64 eng = seeded_pcg(active_seeds);
+    // Sample mutations for each chromosome:
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (uint64 k = 0; k < n_chroms; k++) {
 
-    // Parallelize the Loop
+        if (prog_bar.is_aborted() || prog_bar.check_abort()) status_code = -1;
+        if (status_code != 0) continue;
+
+        const uint64& i(chrom_order[k]);
+
+        pcg64 eng = streams.engine(jlp::rng_ssites, i);
+
+        make_one_chrom_ssites(chrom_muts[i], (*ref_genome)[i], seg_sites[i],
+                              type, insert, eng);
+
+    }
+
+    // Add them to each haplotype in one pass:
 #ifdef _OPENMP
-#pragma omp for schedule(static)
+#pragma omp for schedule(dynamic)
 #endif
-    for (uint64 i = 0; i < n_chroms; i++) {
+    for (uint64 k = 0; k < tasks.size(); k++) {
 
         if (prog_bar.is_aborted() || prog_bar.check_abort()) status_code = -1;
         if (status_code != 0) continue;
 
-        add_one_chrom_ssites(*hap_set, *ref_genome, i, seg_sites[i], type, insert, eng);
+        const uint64& i(tasks[task_order[k]].first);
+        const uint64& j(tasks[task_order[k]].second);
+        const SsitesMuts& muts_i(chrom_muts[i]);
+        const arma::mat& ss_i(seg_sites[i]);
+
+        batch.clear();
+        for (uint64 m = 0; m < muts_i.muts.size(); m++) {
+            if (ss_i(muts_i.rows[m], j+1) == 1) batch.push_back(muts_i.muts[m]);
+        }
+        if (!batch.empty()) {
+            (*hap_set)[j][i].add_ref_mutations(batch, muts_i.seqs);
+        }
 
         prog_bar.increment((*ref_genome)[i].size());
 
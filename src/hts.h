@@ -7,20 +7,22 @@
 #include <RcppArmadillo.h>
 #include <vector>  // vector class
 #include <string>  // string class
+#include <cstring>  // memcpy, memset
+#include <limits>  // numeric_limits
 #include <pcg/pcg_random.hpp> // pcg prng
 #include <fstream> // for writing FASTQ files
 #include "zlib.h"  // for writing to compressed FASTQ
 #include <progress.hpp>  // for the progress bar
+#include <deque>  // deque class
+#include <map>  // map class
+#include <algorithm>  // max, min, upper_bound, fill
+#include <thread>  // thread (for the writer thread)
+#include <mutex>  // mutex, unique_lock
+#include <condition_variable>  // condition_variable
 
 
-// for bgzip_file
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include "htslib/bgzf.h"
-
 #include "jackalope_types.h"  // uint64
-#include "pcg.h"  // ruinf_01
+#include "pcg.h"  // runif_01, RngStreams
 #include "util.h"  // str_stop, thread_check, split_int
 #include "io.h"  // File* types
 #include "alias_sampler.h"  // Alias sampler
@@ -104,6 +106,147 @@ inline std::vector<uint64> reads_per_group(uint64 n_reads,
 
 
 
+/*
+ Splits reads that were already assigned to groups (e.g., chromosomes, or
+ chromosomes within haplotypes) into blocks of consecutive reads.
+ Reads are ordered by group, so a block covers the end of one group's reads,
+ then maybe the full reads of some groups, then the start of another group's.
+
+ This lets reads be made in blocks that each have their own RNG stream, in
+ whatever thread, without changing which reads are made.
+ Counts can be in a vector (one item per group) or a vector of vectors
+ (groups are ordered by outer, then inner index).
+ */
+class ReadBlocks {
+
+public:
+
+    ReadBlocks() : cum_reads(1, 0ULL), starts(), lo(0), hi(0), filled(false) {};
+
+    // Set from the # reads for all groups:
+    void set(const std::vector<uint64>& counts) {
+        cum_reads.assign(1, 0ULL);
+        cum_reads.reserve(counts.size() + 1);
+        for (const uint64& n : counts) cum_reads.push_back(cum_reads.back() + n);
+        starts.clear();
+        lo = hi = 0;
+        filled = false;
+        return;
+    }
+    void set(const std::vector<std::vector<uint64>>& counts) {
+        cum_reads.assign(1, 0ULL);
+        starts.clear();
+        starts.reserve(counts.size());
+        for (const std::vector<uint64>& cc : counts) {
+            starts.push_back(cum_reads.size() - 1);
+            for (const uint64& n : cc) cum_reads.push_back(cum_reads.back() + n);
+        }
+        lo = hi = 0;
+        filled = false;
+        return;
+    }
+
+    // Total # reads:
+    uint64 total() const {
+        return cum_reads.back();
+    }
+
+    /*
+     Change `counts` to only include reads from index `begin` to `begin + n - 1`.
+     `counts` should be the same shape used in `set`, and it should only
+     have been changed by this method and by making reads.
+     The first time this is called after `set`, all of `counts` is cleared,
+     because before then it has the reads for all blocks.
+     After that, only the groups in the last block can be non-zero.
+     */
+    void fill(std::vector<uint64>& counts, const uint64& begin, const uint64& n) {
+        if (!filled) {
+            std::fill(counts.begin(), counts.end(), 0ULL);
+            filled = true;
+        } else {
+            for (uint64 g = lo; g < hi; g++) counts[g] = 0;
+        }
+        fill_range__(begin, n);
+        for (uint64 g = lo; g < hi; g++) counts[g] = n_in_block__(g, begin, n);
+        return;
+    }
+    void fill(std::vector<std::vector<uint64>>& counts,
+              const uint64& begin, const uint64& n) {
+        uint64 outer, inner;
+        if (!filled) {
+            for (std::vector<uint64>& cc : counts) std::fill(cc.begin(), cc.end(), 0ULL);
+            filled = true;
+        } else {
+            for (uint64 g = lo; g < hi; g++) {
+                group_inds__(g, outer, inner);
+                counts[outer][inner] = 0;
+            }
+        }
+        fill_range__(begin, n);
+        for (uint64 g = lo; g < hi; g++) {
+            group_inds__(g, outer, inner);
+            counts[outer][inner] = n_in_block__(g, begin, n);
+        }
+        return;
+    }
+
+    /*
+     Outer and inner indices for the first group in the last block filled.
+     Returns false if that block has no groups.
+     */
+    bool first_group(uint64& outer, uint64& inner) const {
+        if (lo >= hi) return false;
+        group_inds__(lo, outer, inner);
+        return true;
+    }
+
+
+private:
+
+    std::vector<uint64> cum_reads;  // # reads in all groups before each group
+    std::vector<uint64> starts;     // (for nested) first group of each outer index
+    uint64 lo;                      // first group in last block
+    uint64 hi;                      // one past last group in last block
+    bool filled;                    // whether `fill` has been called since `set`
+
+    // Set `lo` and `hi` for a new block:
+    void fill_range__(const uint64& begin, const uint64& n) {
+        const uint64 n_groups = cum_reads.size() - 1;
+        lo = std::upper_bound(cum_reads.begin(), cum_reads.end(), begin) -
+            cum_reads.begin();
+        lo = (lo == 0) ? 0 : lo - 1;
+        if (lo > n_groups) lo = n_groups;
+        hi = lo;
+        while (hi < n_groups && cum_reads[hi] < begin + n) hi++;
+        return;
+    }
+
+    inline uint64 n_in_block__(const uint64& g,
+                               const uint64& begin,
+                               const uint64& n) const {
+        uint64 first = std::max(cum_reads[g], begin);
+        uint64 last = std::min(cum_reads[g+1], begin + n);
+        return (last > first) ? (last - first) : 0ULL;
+    }
+
+    inline void group_inds__(const uint64& g, uint64& outer, uint64& inner) const {
+        if (starts.empty()) {
+            outer = g;
+            inner = 0;
+            return;
+        }
+        // (This skips outer indices with no groups bc it finds the last one
+        // with a start at or before `g`)
+        outer = std::upper_bound(starts.begin(), starts.end(), g) - starts.begin() - 1;
+        inner = g - starts[outer];
+        return;
+    }
+
+};
+
+
+
+
 // Fill read from string rather than haplotype chromosome
 
 inline void fill_read__(const std::string& chrom,
@@ -122,8 +265,8 @@ inline void fill_read__(const std::string& chrom,
     // Make sure the read is long enough (this fxn should never shorten it):
     if (read.size() < n_to_add + read_start) read.resize(n_to_add + read_start, 'N');
 
-    for (uint64 i = 0; i < n_to_add; i++) {
-        read[(read_start + i)] = chrom[(chrom_start + i)];
+    if (n_to_add > 0) {
+        std::memcpy(&read[read_start], chrom.data() + chrom_start, n_to_add);
     }
     return;
 
@@ -132,52 +275,297 @@ inline void fill_read__(const std::string& chrom,
 
 
 
+/*
+ Writes FASTQ records (ID line, read, "+", and qualities) to the end of a pool.
 
-//' bgzip a file, potentially using multiple threads.
-//'
-//' @noRd
-//'
-inline int bgzip_file(const std::string& file_name,
-                      const int& n_threads,
-                      const int& compress) {
+ The start of the ID line ("@<genome name>-<chromosome name>-") is made once per
+ chromosome and kept in `prefix`.
+ Each record is written by resizing the pool once and copying pieces into it,
+ so as long as the pool has enough capacity (pools are re-used after
+ they're written), nothing is allocated.
 
-    // Make writer object:
-    FileBGZF bgzf(file_name, n_threads, compress);
-    // Others used below:
-    void *buffer;
-    int c;
-    struct stat sbuf;
-    int f_src = fileno(stdin);
+ `U` should be a std::string or std::vector<char>.
+ */
+class FastqEncoder {
 
-    const int WINDOW_SIZE = 64 * 1024;
+public:
 
+    FastqEncoder() : prefix(), prefix_chrom(std::numeric_limits<uint64>::max()) {};
+
+    // Set the ID-line prefix, unless it's already set for this chromosome:
+    void set_prefix(const std::string& name,
+                    const std::string& chrom_name,
+                    const uint64& chrom_ind) {
+        if (chrom_ind == prefix_chrom) return;
+        prefix.clear();
+        prefix.reserve(name.size() + chrom_name.size() + 3);
+        prefix.push_back('@');
+        prefix += name;
+        prefix.push_back('-');
+        prefix += chrom_name;
+        prefix.push_back('-');
+        prefix_chrom = chrom_ind;
+        return;
+    }
 
-    // Checking source file:
-    if (stat(file_name.c_str(), &sbuf) < 0) {
-        str_stop({"\nIn bgzip step, file ", file_name,
-                 " had non-zero status: ", strerror(errno), "."});
+    /*
+     Write one record using qualities from a string.
+     `mate` is the read number shown after '/' in the ID line for paired reads;
+     it's not written if it's zero.
+     */
+    template <typename U>
+    void write(U& pool,
+               const uint64& start,
+               const bool& reverse,
+               const uint64& mate,
+               const std::string& read,
+               const std::string& qual) const {
+        char* out = write_header__(pool, start, reverse, mate,
+                                   read.size(), qual.size());
+        out = copy__(out, read.data(), read.size());
+        out = copy__(out, "\n+\n", 3);
+        out = copy__(out, qual.data(), qual.size());
+        *out = '\n';
+        return;
     }
-    if ((f_src = open(file_name.c_str(), O_RDONLY)) < 0) {
-        str_stop({"\nIn bgzip step, file ", file_name, " could not be opened."});
+    /*
+     Same as above, but qualities are `qual_left` for the first `n_left`
+     positions and `qual_right` for the rest.
+     */
+    template <typename U>
+    void write(U& pool,
+               const uint64& start,
+               const bool& reverse,
+               const uint64& mate,
+               const std::string& read,
+               const char& qual_left,
+               const uint64& n_left,
+               const char& qual_right,
+               const uint64& n_right) const {
+        char* out = write_header__(pool, start, reverse, mate,
+                                   read.size(), n_left + n_right);
+        out = copy__(out, read.data(), read.size());
+        out = copy__(out, "\n+\n", 3);
+        if (n_left > 0) std::memset(out, qual_left, n_left);
+        out += n_left;
+        if (n_right > 0) std::memset(out, qual_right, n_right);
+        out += n_right;
+        *out = '\n';
+        return;
     }
 
-    // Create buffer of info to pass between:
-    buffer = malloc(WINDOW_SIZE);
-#ifdef _WIN32
-    _setmode(f_src, O_BINARY);
-#endif
-    // Writing info from one to another
-    while ((c = read(f_src, buffer, WINDOW_SIZE)) > 0) {
-        bgzf.write(buffer, c);
+private:
+
+    std::string prefix;
+    uint64 prefix_chrom;
+
+    inline static char* copy__(char* out, const char* in, const uint64& n) {
+        if (n > 0) std::memcpy(out, in, n);
+        return out + n;
     }
 
-    bgzf.close();
-    unlink(file_name.c_str());
-    free(buffer);
-    close(f_src);
-    return 0;
+    // Write integer digits to the end of `buf` and return # digits written
+    inline static uint64 format_uint__(char* buf_end, uint64 x) {
+        char* p = buf_end;
+        do {
+            *(--p) = static_cast<char>('0' + x % 10);
+            x /= 10;
+        } while (x > 0);
+        return static_cast<uint64>(buf_end - p);
+    }
 
-}
+    /*
+     Resize pool for a whole record, write the ID line, and return a pointer to
+     where the read should start.
+     */
+    template <typename U>
+    char* write_header__(U& pool,
+                         const uint64& start,
+                         const bool& reverse,
+                         const uint64& mate,
+                         const uint64& read_size,
+                         const uint64& qual_size) const {
+
+        char start_buf[20];
+        char mate_buf[20];
+        uint64 n_start = format_uint__(start_buf + 20, start);
+        uint64 n_mate = 0;
+        if (mate > 0) n_mate = format_uint__(mate_buf + 20, mate);
+
+        // prefix + start + "-F" + ["/" + mate] + "\n":
+        uint64 n_header = prefix.size() + n_start + 3;
+        if (mate > 0) n_header += (1 + n_mate);
+
+        uint64 pool_size = pool.size();
+        // header + read + "\n+\n" + qual + "\n":
+        pool.resize(pool_size + n_header + read_size + qual_size + 4);
+
+        char* out = &pool[pool_size];
+        out = copy__(out, prefix.data(), prefix.size());
+        out = copy__(out, start_buf + 20 - n_start, n_start);
+        *(out++) = '-';
+        *(out++) = reverse ? 'R' : 'F';
+        if (mate > 0) {
+            *(out++) = '/';
+            out = copy__(out, mate_buf + 20 - n_mate, n_mate);
+        }
+        *(out++) = '\n';
+
+        return out;
+    }
+
+};
+
+
+
+
+
+/*
+ Writes pools of FASTQ reads to file(s) from a dedicated thread, so that threads
+ making reads don't have to wait for writing or compression.
+ Threads making reads pass full pools (one per read end) to `push`, which
+ queues them for writing and gives back empty pools that were already written.
+ Recycling pools this way means their memory is only allocated once.
+
+ Each set of pools has an index, and they're written in order of this index
+ (starting at zero), no matter which order they're pushed in.
+ So that the writer never waits on a set that no thread is making, indices
+ should be handed out to threads in increasing order, and every index handed out
+ should be pushed.
+ If a set is `max_jobs` or more ahead of the next one to be written,
+ `push` waits until there's room.
+
+ `F` should be `FileUncomp`, `FileGZ`, `FileGZPar`, `FileBGZF`, or `FileBGZFBlocks`.
+ */
+template <typename F>
+class PoolWriteQueue {
+
+public:
+
+    PoolWriteQueue(std::vector<F>& files_,
+                   const uint64& max_jobs_)
+        : files(&files_),
+          max_jobs(std::max(max_jobs_, static_cast<uint64>(1))),
+          jobs(),
+          next_job(0),
+          spares(),
+          done(false),
+          failed(false),
+          mtx(),
+          cv_jobs(),
+          cv_space(),
+          writer() {
+        writer = std::thread(&PoolWriteQueue<F>::write_loop__, this);
+    }
+
+    PoolWriteQueue(const PoolWriteQueue<F>&) = delete;
+    PoolWriteQueue<F>& operator=(const PoolWriteQueue<F>&) = delete;
+
+    ~PoolWriteQueue() {
+        if (writer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                done = true;
+            }
+            cv_jobs.notify_all();
+            writer.join();
+        }
+    }
+
+    /*
+     Queue `pools` to be written and replace them with empty ones.
+     Before being queued, pools are passed through the file's `prepare` method
+     (e.g., for compression), so that happens in the calling thread.
+     */
+    void push(std::vector<std::vector<char>>& pools, const uint64& job_i) {
+        uint64 n_pools = pools.size();
+        std::vector<std::vector<char>> spare;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!spares.empty()) {
+                spare = std::move(spares.back());
+                spares.pop_back();
+            }
+        }
+        spare.resize(n_pools);
+        bool prepared = true;
+        for (uint64 i = 0; i < n_pools; i++) {
+            prepared = prepared && (*files)[i].prepare(pools[i], spare[i]);
+            spare[i].clear();
+        }
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (!prepared) failed = true;
+            cv_space.wait(lock, [&]() { return job_i < next_job + max_jobs; });
+            jobs[job_i] = std::move(pools);
+        }
+        cv_jobs.notify_one();
+        pools = std::move(spare);
+        return;
+    }
+
+    /*
+     Write everything left in the queue, then stop the writer thread.
+     This should only be called outside of parallel regions, since it throws an
+     error if preparing any pool failed.
+     */
+    void close() {
+        if (!writer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            done = true;
+        }
+        cv_jobs.notify_all();
+        writer.join();
+        if (failed) stop("\nCompression of FASTQ output failed.");
+        return;
+    }
+
+
+private:
+
+    std::vector<F>* files;
+    const uint64 max_jobs;
+    std::map<uint64,std::vector<std::vector<char>>> jobs;  // pools to write
+    uint64 next_job;                                       // index to write next
+    std::vector<std::vector<std::vector<char>>> spares;  // written pools
+    bool done;
+    bool failed;
+    std::mutex mtx;
+    std::condition_variable cv_jobs;
+    std::condition_variable cv_space;
+    std::thread writer;
+
+    void write_loop__() {
+        std::vector<std::vector<char>> job;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_jobs.wait(lock, [this]() {
+                    return jobs.count(next_job) > 0 || done;
+                });
+                // (If a set was never pushed, the rest are skipped)
+                auto iter = jobs.find(next_job);
+                if (iter == jobs.end()) return;
+                job = std::move(iter->second);
+                jobs.erase(iter);
+                next_job++;
+            }
+            cv_space.notify_all();
+            for (uint64 i = 0; i < job.size(); i++) {
+                (*files)[i].write(job[i]);
+                job[i].clear();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                spares.push_back(std::move(job));
+            }
+            job = std::vector<std::vector<char>>();
+        }
+        return;
+    }
+
+};
 
 
 
@@ -196,7 +584,7 @@ class ReadWriterOneThread {
 public:
 
     T* read_filler;
-    const uint64 n_reads;           // # reads to create
+    uint64 n_reads;                 // # reads to create (in the current block)
     const uint64 read_pool_size;    // reads per pool
     uint64 reads_made;              // Number of reads already made
     uint64 reads_in_pool;           // Number of reads in current pool
@@ -221,6 +609,16 @@ public:
           fastq_pools(n_read_ends_) {};
 
 
+    // Start a new block of `n_reads_` reads:
+    void new_block(const uint64& n_reads_) {
+        n_reads = n_reads_;
+        reads_made = 0;
+        reads_in_pool = 0;
+        do_write = false;
+        return;
+    }
+
+
     // Write contents in `fastq_pools` to UNcompressed file(s).
     void write(std::vector<F>& files) {
         for (uint64 i = 0; i < fastq_pools.size(); i++) {
@@ -231,6 +629,13 @@ public:
         do_write = false;
         return;
     }
+    /* Overloaded to pass contents to a queue that writes them: */
+    void write(PoolWriteQueue<F>& queue, const uint64& job_i) {
+        queue.push(fastq_pools, job_i);
+        reads_in_pool = 0;
+        do_write = false;
+        return;
+    }
     /* Overloaded for one file: */
     void write(F& file) {
         file.write(fastq_pools[0]);
@@ -315,9 +720,9 @@ public:
  This should only be called inside that function.
 
  `T` should be `[Illumina|PacBio]Reference` or `[Illumina|PacBio]Haplotypes`.
- `T` should have an `add_n_reads` method.
+ `T` should have `add_n_reads` and `set_block` methods.
 
- `F` should be `FileUncomp`, `FileGZ`, or `FileBGZF`.
+ `F` should be `FileUncomp`, `FileGZ`, `FileGZPar`, `FileBGZF`, or `FileBGZFBlocks`.
 
  */
 template <typename T, typename F>
@@ -331,26 +736,43 @@ inline void write_reads_one_filetype_(const T& read_filler_base,
                                       const int& compress,
                                       Progress& prog_bar) {
 
-    n_reads /= n_read_ends;
-    std::vector<uint64> reads_per_thread = split_int(n_reads, n_threads);
-    for (uint64& i : reads_per_thread) i *= n_read_ends;
+    /*
+     Reads are made in blocks of consecutive reads (see `ReadBlocks`), each with
+     its own RNG stream and written in order, so output doesn't depend on
+     the number of threads.
+     A block fills at most one pool.
+     */
+    n_reads = (n_reads / n_read_ends) * n_read_ends;
+    uint64 block_size = (read_pool_size / n_read_ends) * n_read_ends;
+    if (block_size == 0) block_size = n_read_ends;
+    const uint64 n_blocks = (n_reads + block_size - 1) / block_size;
+    uint64 next_block = 0;
 
-    // Generate seeds for random number generators (1 RNG per thread)
-    const std::vector<std::vector<uint64>> seeds = mt_seeds(n_threads);
+    const RngStreams streams;
 
-    // Create and open files:
+    /*
+     Create and open files.
+     Files that compress using their own threads (`FileGZPar`) split `n_threads`
+     among them, so paired output doesn't start twice as many threads.
+     */
     std::vector<F> files(n_read_ends);
     for (uint64 i = 0; i < n_read_ends; i++) {
         std::string file_name = out_prefix + "_R" + std::to_string(i+1) + ".fq";
-        files[i].set(file_name, compress);
+        uint64 file_threads = (n_threads + n_read_ends - 1 - i) / n_read_ends;
+        if (file_threads == 0) file_threads = 1;
+        files[i].set(file_name, static_cast<int>(file_threads), compress);
     }
 
-    // Create read filler for each thread:
-    std::vector<T> read_fillers;
-    for (uint64 i = 0; i < n_threads; i++) {
-        read_fillers.push_back(read_filler_base);
-        read_fillers.back().add_n_reads(reads_per_thread[i]);
-    }
+    /*
+     All writing happens in its own thread, so threads making reads don't wait
+     on each other to write or compress.
+     */
+    PoolWriteQueue<F> write_queue(files, 2 * n_threads);
+
+    // Assign reads to haplotypes and chromosomes, then copy for each thread:
+    T read_filler_all(read_filler_base);
+    read_filler_all.add_n_reads(n_reads);
+    std::vector<T> read_fillers(n_threads, read_filler_all);
 
 
 #ifdef _OPENMP
@@ -358,69 +780,78 @@ inline void write_reads_one_filetype_(const T& read_filler_base,
 {
 #endif
 
-    std::vector<uint64> active_seeds;
-
-    // Write the active seed per thread or just write one of the seeds.
 #ifdef _OPENMP
     uint64 active_thread = omp_get_thread_num();
 #else
     uint64 active_thread = 0;
 #endif
-    active_seeds = seeds[active_thread];
 
-    pcg64 eng = seeded_pcg(active_seeds);
+    T& read_filler(read_fillers[active_thread]);
 
-    uint64 reads_this_thread = reads_per_thread[active_thread];
-
-    ReadWriterOneThread<T,F> writer(read_fillers[active_thread], reads_this_thread,
+    ReadWriterOneThread<T,F> writer(read_filler, block_size,
                                     read_pool_size, prob_dup, n_read_ends);
 
     uint64 reads_written;
     uint64 old_reads = 0;
     uint64 new_reads = 0;
+    uint64 block_i;
 
-    while (writer.reads_made < reads_this_thread) {
-
-        old_reads = writer.pool_size();
-
-        writer.create_reads(eng);
-
-        new_reads += (writer.pool_size() - old_reads);
+    while (!prog_bar.is_aborted()) {
 
         /*
-         Every 10,000 characters created, check that the user hasn't
-         interrupted the process.
-         (Doing it this way makes the check approximately the same between
-          illumina and pacbio.)
+         Blocks are taken in increasing order, which `write_queue` requires.
+         Every block taken must be passed to `write_queue`, even if the user
+         interrupts making it.
          */
-        if (new_reads > 10000) {
-            if (prog_bar.check_abort()) break;
-            new_reads = 0;
-        }
-
-        if (writer.do_write) {
-            // Save info for progress bar:
-            reads_written = writer.reads_in_pool;
-            // Write to files:
 #ifdef _OPENMP
-#pragma omp critical
-{
-#endif
-            writer.write(files);
-#ifdef _OPENMP
-}
+#pragma omp atomic capture
 #endif
-            // Increment progress bar
-            prog_bar.increment(reads_written);
+        block_i = next_block++;
 
+        if (block_i >= n_blocks) break;
+
+        const uint64 block_start = block_i * block_size;
+        const uint64 block_reads = std::min(block_size, n_reads - block_start);
+
+        pcg64 eng = streams.engine(jlp::rng_reads, block_i);
+        read_filler.set_block(block_start, block_reads);
+        writer.new_block(block_reads);
+
+        while (writer.reads_made < block_reads) {
+
+            old_reads = writer.pool_size();
+
+            writer.create_reads(eng);
+
+            new_reads += (writer.pool_size() - old_reads);
+
+            /*
+             Every 10,000 characters created, check that the user hasn't
+             interrupted the process.
+             (Doing it this way makes the check approximately the same between
+              illumina and pacbio.)
+             */
+            if (new_reads > 10000) {
+                if (prog_bar.check_abort()) break;
+                new_reads = 0;
+            }
         }
+
+        // Save info for progress bar:
+        reads_written = writer.reads_in_pool;
+        // Pass to writing thread:
+        writer.write(write_queue, block_i);
+        // Increment progress bar
+        prog_bar.increment(reads_written);
+
     }
 
 #ifdef _OPENMP
 }
 #endif
 
-    // Close files
+    // Finish writing, then close files
+    write_queue.close();
     for (uint64 i = 0; i < files.size(); i++) {
         files[i].close();
     }
@@ -470,24 +901,29 @@ inline void write_reads_cpp_(const T& read_filler_base,
         } else stop("\nUnrecognized compression method.");
 
     /*
-     Compressed output run in parallel.
-     The only way I've found to make this actually have a speed advantage over
-     running serially is to make it first write to uncompressed output in parallel,
-     then do the compression using `BGZF` also in parallel.
+     bgzipped output run in parallel.
+     Each thread compresses its own reads into BGZF blocks, and these blocks
+     are written directly to the output file(s).
+     */
+    } else if (compress > 0 && n_threads > 1 && comp_method == "bgzip") {
+
+        write_reads_one_filetype_<T, FileBGZFBlocks>(
+                read_filler_base, out_prefix, n_reads, prob_dup,
+                read_pool_size, n_read_ends, n_threads, compress, prog_bar);
+
+    /*
+     gzipped output run in parallel.
+     The writing thread splits output into chunks that are compressed by
+     multiple threads (see `FileGZPar` in `io.h`).
      */
     } else if (compress > 0 && n_threads > 1) {
 
-        // First do it uncompressed:
-        write_reads_one_filetype_<T, FileUncomp>(
+        if (comp_method != "gzip") stop("\nUnrecognized compression method.");
+
+        write_reads_one_filetype_<T, FileGZPar>(
                 read_filler_base, out_prefix, n_reads, prob_dup,
                 read_pool_size, n_read_ends, n_threads, compress, prog_bar);
-        for (uint64 i = 0; i < n_read_ends; i++) {
-            std::string file_name = out_prefix + "_R" + std::to_string(i+1)+ ".fq";
-            bgzip_file(file_name, static_cast<int>(n_threads),
-                       static_cast<int>(compress));
-            // For progress bar, I assume compression takes half as long:
-            prog_bar.increment(n_reads / (n_read_ends * 2));
-        }
+
     // Uncompressed output run in serial or parallel
     } else {
         write_reads_one_filetype_<T, FileUncomp>(
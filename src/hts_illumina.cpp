@@ -282,50 +282,6 @@ void IlluminaOneGenome<T>::just_indels(pcg64& eng) {
 }
 
 
-template <typename U>
-void fill_fq_lines(U& fq_pool,
-                   const std::string& name,
-                   const std::string& chrom_name,
-                   const std::string& read,
-                   const std::string& qual,
-                   const uint64& i,
-                   const uint64& start,
-                   const bool& paired,
-                   bool& reverse) {
-
-    // Combine into 4 lines of output per read:
-    // ID line:
-    fq_pool.push_back('@');
-    for (const char& c : name) fq_pool.push_back(c);
-    fq_pool.push_back('-');
-    for (const char& c : chrom_name) fq_pool.push_back(c);
-    fq_pool.push_back('-');
-    for (const char& c : std::to_string(start)) fq_pool.push_back(c);
-    fq_pool.push_back('-');
-    if (reverse) {
-        fq_pool.push_back('R');
-    } else fq_pool.push_back('F');
-    if (paired) {
-        fq_pool.push_back('/');
-        for (const char& c : std::to_string(i+1)) fq_pool.push_back(c);
-    }
-    fq_pool.push_back('\n');
-    // The rest:
-    for (const char& c : read) fq_pool.push_back(c);
-    fq_pool.push_back('\n');
-    fq_pool.push_back('+');
-    fq_pool.push_back('\n');
-    for (const char& c : qual) fq_pool.push_back(c);
-    fq_pool.push_back('\n');
-
-    // If doing paired reads, the second one should be the reverse of the first
-    reverse = !reverse;
-
-    return;
-
-}
-
-
 
 
 /*
@@ -348,6 +304,9 @@ void IlluminaOneGenome<T>::append_pools(std::vector<U>& fastq_pools,
     // Just making this reference to keep lines from getting very long.
     const uint64& chrom_ind(constr_info.chrom_ind);
 
+    // Start of ID lines (only re-made when the chromosome changes):
+    fq_encoder.set_prefix(name, (*chromosomes)[chrom_ind].name, chrom_ind);
+
     // Boolean for whether we take the reverse side first:
     bool reverse = runif_01(eng) < 0.5;
     for (uint64 i = 0; i < n_read_ends; i++) {
@@ -391,13 +350,15 @@ void IlluminaOneGenome<T>::append_pools(std::vector<U>& fastq_pools,
         for (uint64 i = 0; i < barcode.size(); i++) read[i] = barcode[i];
 
         // Sample mapping quality and add errors to read:
-        qual_errors[i].fill_read_qual(read, qual, insertions[i], deletions[i], eng);
-
-        std::string chrom_name = (*chromosomes)[chrom_ind].name;
+        qual_errors[i].fill_read_qual(read, qual, insertions[i], deletions[i], eng,
+                                      qual_rng);
 
         // Combine into 4 lines of output per read, and add to `fastq_pools[i]`
-        fill_fq_lines<U>(fastq_pools[i], name, chrom_name, read, qual, i, start,
-                         paired, reverse);
+        fq_encoder.write(fastq_pools[i], start, reverse, paired ? (i+1) : 0,
+                         read, qual);
+
+        // If doing paired reads, the second one should be the reverse of the first
+        reverse = !reverse;
 
     }
 
@@ -424,6 +385,9 @@ void IlluminaOneGenome<T>::append_pools(const std::string& chrom,
     // Just making this reference to keep lines from getting very long.
     const uint64& chrom_ind(constr_info.chrom_ind);
 
+    // Start of ID lines (only re-made when the chromosome changes):
+    fq_encoder.set_prefix(name, (*chromosomes)[chrom_ind].name, chrom_ind);
+
     // Boolean for whether we take the reverse side first:
     bool reverse = runif_01(eng) < 0.5;
     for (uint64 i = 0; i < n_read_ends; i++) {
@@ -468,13 +432,15 @@ void IlluminaOneGenome<T>::append_pools(const std::string& chrom,
         for (uint64 i = 0; i < barcode.size(); i++) read[i] = barcode[i];
 
         // Sample mapping quality and add errors to read:
-        qual_errors[i].fill_read_qual(read, qual, insertions[i], deletions[i], eng);
-
-        std::string chrom_name = (*chromosomes)[chrom_ind].name;
+        qual_errors[i].fill_read_qual(read, qual, insertions[i], deletions[i], eng,
+                                      qual_rng);
 
         // Combine into 4 lines of output per read, and add to `fastq_pools[i]`
-        fill_fq_lines<U>(fastq_pools[i], name, chrom_name, read, qual, i, start,
-                         paired, reverse);
+        fq_encoder.write(fastq_pools[i], start, reverse, paired ? (i+1) : 0,
+                         read, qual);
+
+        // If doing paired reads, the second one should be the reverse of the first
+        reverse = !reverse;
 
     }
 
@@ -502,7 +468,7 @@ void IlluminaHaplotypes::one_read(std::vector<U>& fastq_pools,
         return;
     }
 
-    if (n_reads_vc[hap][chr] == 0 || hap_chrom_seq.empty()) {
+    if (n_reads_vc[hap][chr] == 0 || !hap_chrom_seq) {
 
         uint64 new_hap = hap;
         uint64 new_chr = chr;
@@ -521,13 +487,14 @@ void IlluminaHaplotypes::one_read(std::vector<U>& fastq_pools,
 
         if (hap == haplotypes->size())  {
             finished = true;
+            hap_chrom_seq.reset();
             return;
         }
 
-        hap_chrom_seq = (*haplotypes)[hap][chr].get_chrom_full();
+        hap_chrom_seq = chrom_cache->get(hap, chr);
     }
 
-    read_makers[hap].one_read<U>(hap_chrom_seq, chr, fastq_pools, eng);
+    read_makers[hap].one_read<U>(*hap_chrom_seq, chr, fastq_pools, eng);
 
     n_reads_vc[hap][chr]--;
     if (paired && n_reads_vc[hap][chr] > 0) n_reads_vc[hap][chr]--;
@@ -549,7 +516,7 @@ void IlluminaHaplotypes::re_read(std::vector<U>& fastq_pools,
         return;
     }
 
-    read_makers[hap].re_read<U>(hap_chrom_seq, chr, fastq_pools, eng);
+    read_makers[hap].re_read<U>(*hap_chrom_seq, chr, fastq_pools, eng);
 
     if (n_reads_vc[hap][chr] > 0) n_reads_vc[hap][chr]--;
     if (paired && n_reads_vc[hap][chr] > 0) n_reads_vc[hap][chr]--;
@@ -635,11 +602,8 @@ void illumina_ref_cpp(SEXP ref_genome_ptr,
                               barcodes[0]);
     }
 
-    // For doing multithreaded compression after initial uncompressed run:
-    uint64 prog_n = n_reads;
-    if (compress > 0 && n_threads > 1) prog_n += (n_reads / 2);
     // Progress bar:
-    Progress prog_bar(prog_n, show_progress);
+    Progress prog_bar(n_reads, show_progress);
 
     write_reads_cpp_<IlluminaReference>(
         read_filler_base, out_prefix, n_reads, prob_dup, read_pool_size,
@@ -684,7 +648,8 @@ void illumina_hap_cpp(SEXP hap_set_ptr,
                       const std::vector<std::vector<std::vector<uint8>>>& quals2,
                       const double& ins_prob2,
                       const double& del_prob2,
-                      const std::vector<std::string>& barcodes) {
+                      const std::vector<std::string>& barcodes,
+                      const uint64& hap_cache_bytes) {
 
     XPtr<HapSet> hap_set(hap_set_ptr);
     IlluminaHaplotypes read_filler_base;
@@ -700,7 +665,7 @@ void illumina_hap_cpp(SEXP hap_set_ptr,
                                             frag_len_min, frag_len_max,
                                             qual_probs1, quals1, ins_prob1, del_prob1,
                                             qual_probs2, quals2, ins_prob2, del_prob2,
-                                            barcodes);
+                                            barcodes, hap_cache_bytes);
 
     } else {
 
@@ -709,15 +674,12 @@ void illumina_hap_cpp(SEXP hap_set_ptr,
                                             frag_len_shape, frag_len_scale,
                                             frag_len_min, frag_len_max,
                                             qual_probs1, quals1, ins_prob1, del_prob1,
-                                            barcodes);
+                                            barcodes, hap_cache_bytes);
 
     }
 
-    // For doing multithreaded compression after initial uncompressed run:
-    uint64 prog_n = n_reads;
-    if (compress > 0 && n_threads > 1) prog_n += (n_reads / 2);
     // Progress bar:
-    Progress prog_bar(prog_n, show_progress);
+    Progress prog_bar(n_reads, show_progress);
 
     if (sep_files) {
 
@@ -18,7 +18,8 @@
 #include "jackalope_types.h"  // integer types
 #include "ref_classes.h"  // Ref* classes
 #include "hap_classes.h"  // Hap* classes
-#include "pcg.h"  // runif_01
+#include "hap_cache.h"  // HapChromCache
+#include "pcg.h"  // runif_01, RngBuffer
 #include "alias_sampler.h"  // AliasSampler
 #include "hts.h"  // generic sequencing class
 
@@ -130,6 +131,12 @@ public:
         uint64 k = samplers[pos].sample(eng);
         return quals[pos][k];
     }
+    // Same as above, but from one raw 64-bit draw
+    uint8 sample(const uint64& pos,
+                 const uint64& bits) const {
+        uint64 k = samplers[pos].sample_bits(bits);
+        return quals[pos][k];
+    }
 
 
 
@@ -198,14 +205,16 @@ public:
      Because small fragments could cause the read length to be less than normal,
      I'm requiring it as input to this function.
      `read` should already be sized appropriately before this function.
+     `rng` should only ever be used with `eng`, and it's kept between reads.
      */
     void fill_read_qual(std::string& read,
                         std::string& qual,
                         std::deque<uint64>& insertions,
                         std::deque<uint64>& deletions,
-                        pcg64& eng) const {
+                        pcg64& eng,
+                        RngBuffer& rng) const {
 
-        double mis_prob, u;
+        double mis_prob;
         uint8 nt_ind, qint;
         /*
          Add indels:
@@ -213,7 +222,7 @@ public:
         uint64 chrom_pos = read.size() - 1ULL;
         while (!insertions.empty() || !deletions.empty()) {
             if (!insertions.empty() && chrom_pos == insertions.back()) {
-                char c = jlp::bases[static_cast<uint64>(runif_01(eng) * 4.0)];
+                char c = jlp::bases[rng.index(eng, 4)];
                 read.insert(chrom_pos + 1, 1, c);
                 insertions.pop_back();
             } else if (!deletions.empty() && chrom_pos == deletions.back()) {
@@ -235,7 +244,7 @@ public:
              than 10. This is what ART does.
              */
             if (nt_ind > 3) {
-                qint = runif_01(eng) * 10 + qual_start;
+                qint = rng.index(eng, 10) + qual_start;
                 qual[pos] = static_cast<char>(qint);
                 nt = 'N';
                 continue;
@@ -244,14 +253,13 @@ public:
              Otherwise, qualities are based on the nucleotide and position,
              and Pr(mismatch) is proportional to quality:
              */
-            qint = by_nt[nt_ind].sample(pos, eng);
+            qint = by_nt[nt_ind].sample(pos, rng.next(eng));
             mis_prob = qual_prob_map[qint];
             qint += qual_start;
             qual[pos] = static_cast<char>(qint);
-            u = runif_01(eng);
-            if (u < mis_prob) {
+            if (rng.unif_01f(eng) < mis_prob) {
                 const std::string& mm_str(mm_nucleos[nt_ind]);
-                nt = mm_str[static_cast<uint64>(runif_01(eng) * 3.0)];
+                nt = mm_str[rng.index(eng, 3)];
             }
         }
 
@@ -344,7 +352,10 @@ public:
           deletions(2),
           frag_len_min(frag_len_min_),
           frag_len_max(frag_len_max_),
-          constr_info(paired, read_length, barcode) {
+          constr_info(paired, read_length, barcode),
+          fq_encoder(),
+          read_blocks(),
+          qual_rng() {
               if (qual_probs1[0].size() != qual_probs2[0].size()) {
                   std::string err = "In IlluminaOneGenome constr., read lengths for ";
                   err += "R1 and R2 don't match.";
@@ -383,7 +394,10 @@ public:
           deletions(1),
           frag_len_min(frag_len_min_),
           frag_len_max(frag_len_max_),
-          constr_info(paired, read_length, barcode) {
+          constr_info(paired, read_length, barcode),
+          fq_encoder(),
+          read_blocks(),
+          qual_rng() {
               ins_probs[0] = ins_prob;
               del_probs[0] = del_prob;
           };
@@ -404,7 +418,10 @@ public:
           deletions(other.deletions),
           frag_len_min(other.frag_len_min),
           frag_len_max(other.frag_len_max),
-          constr_info(other.constr_info) {};
+          constr_info(other.constr_info),
+          fq_encoder(other.fq_encoder),
+          read_blocks(other.read_blocks),
+          qual_rng() {};
 
 
     void add_n_reads(uint64 n_reads) {
@@ -413,10 +430,31 @@ public:
         if (paired) n_reads /= 2; // now it's pairs of reads
         chrom_reads = reads_per_group(n_reads, probs_);
         if (paired) for (uint64& r : chrom_reads) r *= 2;  // back to # reads
+        read_blocks.set(chrom_reads);
 
         return;
     }
 
+    /*
+     Only make reads from index `begin` to `begin + n - 1` (among all reads
+     from `add_n_reads`) until this is called again.
+     */
+    void set_block(const uint64& begin, const uint64& n) {
+        read_blocks.fill(chrom_reads, begin, n);
+        reset_distr();
+        return;
+    }
+
+    /*
+     Reset distribution(s) and buffered draws so that output only depends on the
+     RNG that follows:
+     */
+    void reset_distr() {
+        frag_lengths.reset();
+        qual_rng.reset();
+        return;
+    }
+
 
     // Sample one set of read strings (each with 4 lines: ID, chromosome, "+", quality)
     // `U` should be a std::string or std::vector<char>
@@ -450,6 +488,12 @@ protected:
     uint64 frag_len_max;
     // Info to construct reads:
     IlluminaReadConstrInfo constr_info;
+    // Writes reads to FASTQ pools:
+    FastqEncoder fq_encoder;
+    // Splits reads from `add_n_reads` into blocks:
+    ReadBlocks read_blocks;
+    // Buffered draws for qualities and mismatches, kept between reads:
+    RngBuffer qual_rng;
 
 
     // Sample for insertion and deletion positions
@@ -537,7 +581,8 @@ public:
                      const std::vector<std::vector<std::vector<uint8>>>& quals2,
                      const double& ins_prob2,
                      const double& del_prob2,
-                     std::vector<std::string> barcodes)
+                     std::vector<std::string> barcodes,
+                     const uint64& cache_bytes = jlp::hap_cache_bytes)
         : haplotypes(&hap_set),
           n_reads_vc(),
           read_makers(),
@@ -545,7 +590,9 @@ public:
           hap_probs(haplotype_probs),
           hap(0),
           chr(0),
-          hap_chrom_seq() {
+          hap_chrom_seq(),
+          chrom_cache(std::make_shared<HapChromCache>(hap_set, cache_bytes)),
+          read_blocks() {
 
         if (barcodes.size() < hap_set.size()) barcodes.resize(hap_set.size(), "");
 
@@ -579,7 +626,8 @@ public:
                      const std::vector<std::vector<std::vector<uint8>>>& quals,
                      const double& ins_prob,
                      const double& del_prob,
-                     std::vector<std::string> barcodes)
+                     std::vector<std::string> barcodes,
+                     const uint64& cache_bytes = jlp::hap_cache_bytes)
         : haplotypes(&hap_set),
           n_reads_vc(),
           read_makers(),
@@ -587,7 +635,9 @@ public:
           hap_probs(haplotype_probs),
           hap(0),
           chr(0),
-          hap_chrom_seq() {
+          hap_chrom_seq(),
+          chrom_cache(std::make_shared<HapChromCache>(hap_set, cache_bytes)),
+          read_blocks() {
 
         if (barcodes.size() < hap_set.size()) barcodes.resize(hap_set.size(), "");
 
@@ -613,7 +663,8 @@ public:
         : haplotypes(other.haplotypes), n_reads_vc(other.n_reads_vc),
           read_makers(other.read_makers), paired(other.paired),
           hap_probs(other.hap_probs),
-          hap(other.hap), chr(other.chr), hap_chrom_seq(other.hap_chrom_seq) {};
+          hap(other.hap), chr(other.chr), hap_chrom_seq(other.hap_chrom_seq),
+          chrom_cache(other.chrom_cache), read_blocks(other.read_blocks) {};
 
 
     // Add info on # reads
@@ -626,6 +677,7 @@ public:
         std::vector<uint64> hap_reads = reads_per_group(n_reads, hap_probs);
 
         // splitting by chromosome, too:
+        n_reads_vc.clear();
         for (uint64 v = 0; v < n_haps; v++) {
             std::vector<double> chrom_probs;
             for (const HapChrom& vc : (*haplotypes)[v].chromosomes) {
@@ -634,6 +686,7 @@ public:
             n_reads_vc.push_back(reads_per_group(hap_reads[v], chrom_probs));
             if (paired) for (uint64& r : n_reads_vc.back()) r *= 2;  // back to # reads
         }
+        read_blocks.set(n_reads_vc);
 
         // Fill `read_makers` field:
         for (uint64 i = 0; i < n_haps; i++) {
@@ -644,6 +697,23 @@ public:
     }
 
 
+    /*
+     Only make reads from index `begin` to `begin + n - 1` (among all reads
+     from `add_n_reads`) until this is called again.
+     */
+    void set_block(const uint64& begin, const uint64& n) {
+        read_blocks.fill(n_reads_vc, begin, n);
+        uint64 new_hap = haplotypes->size();
+        uint64 new_chr = 0;
+        read_blocks.first_group(new_hap, new_chr);
+        if (new_hap != hap || new_chr != chr) hap_chrom_seq.reset();
+        hap = new_hap;
+        chr = new_chr;
+        for (IlluminaOneHaplotype& rm : read_makers) rm.reset_distr();
+        return;
+    }
+
+
     /*
      -------------
      `one_read` methods
@@ -670,7 +740,11 @@ private:
     // Chromosome to create read from.
     uint64 chr;
     // String for haplotype chromosome. It's saved to make things faster.
-    std::string hap_chrom_seq;
+    HapChromCache::SeqPtr hap_chrom_seq;
+    // Full chromosome sequences, shared among copies of this object (i.e., threads):
+    std::shared_ptr<HapChromCache> chrom_cache;
+    // Splits reads from `add_n_reads` into blocks:
+    ReadBlocks read_blocks;
 
 };
 
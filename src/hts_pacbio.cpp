@@ -184,6 +184,8 @@ void PacBioOneGenome<T>::one_read(std::vector<U>& fastq_pools,
     // Fill the reads and qualities
     append_pool<U>(fastq_pool, eng);
 
+    chrom_reads[chrom_ind]--;
+
     return;
 }
 
@@ -285,6 +287,8 @@ void PacBioOneGenome<T>::re_read(std::vector<U>& fastq_pools,
     // Fill the reads and qualities
     append_pool<U>(fastq_pool, eng);
 
+    if (chrom_reads[chrom_ind] > 0) chrom_reads[chrom_ind]--;
+
     return;
 }
 
@@ -349,25 +353,9 @@ template <typename T>
 template <typename U>
 void PacBioOneGenome<T>::append_pool(U& fastq_pool, pcg64& eng) {
 
-    // Make sure it has enough memory reserved:
-    fastq_pool.reserve(fastq_pool.size() + read_length * 3 + 10);
-
     // Boolean for whether we take the reverse side:
     bool reverse = runif_01(eng) < 0.5;
 
-    // ID line:
-    fastq_pool.push_back('@');
-    for (const char& c : name) fastq_pool.push_back(c);
-    fastq_pool.push_back('-');
-    for (const char& c : (*chromosomes)[chrom_ind].name) fastq_pool.push_back(c);
-    fastq_pool.push_back('-');
-    for (const char& c : std::to_string(read_start)) fastq_pool.push_back(c);
-    fastq_pool.push_back('-');
-    if (reverse) {
-        fastq_pool.push_back('R');
-    } else fastq_pool.push_back('F');
-    fastq_pool.push_back('\n');
-
     // Fill in read:
     (*chromosomes)[chrom_ind].fill_read(read, 0, read_start, read_chrom_space);
 
@@ -377,38 +365,32 @@ void PacBioOneGenome<T>::append_pool(U& fastq_pool, pcg64& eng) {
     /*
      Adding read with errors:
      */
+    read_out.clear();
+    read_out.reserve(read_length + 1);
     uint64 read_pos = 0;
-    uint64 current_length = 0;
     uint64 rndi;
-    while (current_length < read_length) {
+    while (read_out.size() < read_length) {
         if (!insertions.empty() && read_pos == insertions.front()) {
             rndi = static_cast<uint64>(runif_01(eng) * 4);
-            fastq_pool.push_back(read[read_pos]);
-            fastq_pool.push_back(jlp::bases[rndi]);
+            read_out.push_back(read[read_pos]);
+            read_out.push_back(jlp::bases[rndi]);
             insertions.pop_front();
-            current_length += 2;
         } else if (!deletions.empty() && read_pos == deletions.front()) {
             deletions.pop_front();
         } else if (!substitutions.empty() && read_pos == substitutions.front()) {
             rndi = static_cast<uint64>(runif_01(eng) * 3);
-            fastq_pool.push_back(mm_nucleos[nt_map[read[read_pos]]][rndi]);
+            read_out.push_back(mm_nucleos[nt_map[read[read_pos]]][rndi]);
             substitutions.pop_front();
-            current_length++;
         } else {
-            fastq_pool.push_back(read[read_pos]);
-            current_length++;
+            read_out.push_back(read[read_pos]);
         }
         read_pos++;
     }
 
-    fastq_pool.push_back('\n');
-    fastq_pool.push_back('+');
-    fastq_pool.push_back('\n');
-
-    // Adding qualities:
-    for (uint64 i = 0; i < split_pos; i++) fastq_pool.push_back(qual_left);
-    for (uint64 i = split_pos; i < read_length; i++) fastq_pool.push_back(qual_right);
-    fastq_pool.push_back('\n');
+    // Add ID line, read, and qualities to pool:
+    fq_encoder.set_prefix(name, (*chromosomes)[chrom_ind].name, chrom_ind);
+    fq_encoder.write(fastq_pool, read_start, reverse, 0, read_out,
+                     qual_left, split_pos, qual_right, read_length - split_pos);
 
     return;
 }
@@ -420,25 +402,9 @@ void PacBioOneGenome<T>::append_pool(const std::string& chrom,
                                      U& fastq_pool,
                                      pcg64& eng) {
 
-    // Make sure it has enough memory reserved:
-    fastq_pool.reserve(fastq_pool.size() + read_length * 3 + 10);
-
     // Boolean for whether we take the reverse side:
     bool reverse = runif_01(eng) < 0.5;
 
-    // ID line:
-    fastq_pool.push_back('@');
-    for (const char& c : name) fastq_pool.push_back(c);
-    fastq_pool.push_back('-');
-    for (const char& c : (*chromosomes)[chrom_ind].name) fastq_pool.push_back(c);
-    fastq_pool.push_back('-');
-    for (const char& c : std::to_string(read_start)) fastq_pool.push_back(c);
-    fastq_pool.push_back('-');
-    if (reverse) {
-        fastq_pool.push_back('R');
-    } else fastq_pool.push_back('F');
-    fastq_pool.push_back('\n');
-
     // Fill in read:
     fill_read__(chrom, read, 0, read_start, read_chrom_space);
 
@@ -448,38 +414,32 @@ void PacBioOneGenome<T>::append_pool(const std::string& chrom,
     /*
      Adding read with errors:
      */
+    read_out.clear();
+    read_out.reserve(read_length + 1);
     uint64 read_pos = 0;
-    uint64 current_length = 0;
     uint64 rndi;
-    while (current_length < read_length) {
+    while (read_out.size() < read_length) {
         if (!insertions.empty() && read_pos == insertions.front()) {
             rndi = static_cast<uint64>(runif_01(eng) * 4);
-            fastq_pool.push_back(read[read_pos]);
-            fastq_pool.push_back(jlp::bases[rndi]);
+            read_out.push_back(read[read_pos]);
+            read_out.push_back(jlp::bases[rndi]);
             insertions.pop_front();
-            current_length += 2;
         } else if (!deletions.empty() && read_pos == deletions.front()) {
             deletions.pop_front();
         } else if (!substitutions.empty() && read_pos == substitutions.front()) {
             rndi = static_cast<uint64>(runif_01(eng) * 3);
-            fastq_pool.push_back(mm_nucleos[nt_map[read[read_pos]]][rndi]);
+            read_out.push_back(mm_nucleos[nt_map[read[read_pos]]][rndi]);
             substitutions.pop_front();
-            current_length++;
         } else {
-            fastq_pool.push_back(read[read_pos]);
-            current_length++;
+            read_out.push_back(read[read_pos]);
         }
         read_pos++;
     }
 
-    fastq_pool.push_back('\n');
-    fastq_pool.push_back('+');
-    fastq_pool.push_back('\n');
-
-    // Adding qualities:
-    for (uint64 i = 0; i < split_pos; i++) fastq_pool.push_back(qual_left);
-    for (uint64 i = split_pos; i < read_length; i++) fastq_pool.push_back(qual_right);
-    fastq_pool.push_back('\n');
+    // Add ID line, read, and qualities to pool:
+    fq_encoder.set_prefix(name, (*chromosomes)[chrom_ind].name, chrom_ind);
+    fq_encoder.write(fastq_pool, read_start, reverse, 0, read_out,
+                     qual_left, split_pos, qual_right, read_length - split_pos);
 
     return;
 }
@@ -499,7 +459,7 @@ void PacBioHaplotypes::one_read(std::vector<U>& fastq_pools, bool& finished, pcg
         return;
     }
 
-    if (n_reads_vc[hap][chr] == 0 || hap_chrom_seq.empty()) {
+    if (n_reads_vc[hap][chr] == 0 || !hap_chrom_seq) {
 
         uint64 new_hap = hap;
         uint64 new_chr = chr;
@@ -518,13 +478,14 @@ void PacBioHaplotypes::one_read(std::vector<U>& fastq_pools, bool& finished, pcg
 
         if (hap == haplotypes->size())  {
             finished = true;
+            hap_chrom_seq.reset();
             return;
         }
 
-        hap_chrom_seq = (*haplotypes)[hap][chr].get_chrom_full();
+        hap_chrom_seq = chrom_cache->get(hap, chr);
     }
 
-    read_makers[hap].one_read<U>(hap_chrom_seq, chr, fastq_pools, eng);
+    read_makers[hap].one_read<U>(*hap_chrom_seq, chr, fastq_pools, eng);
 
     n_reads_vc[hap][chr]--;
 
@@ -542,7 +503,7 @@ void PacBioHaplotypes::re_read(std::vector<U>& fastq_pools, bool& finished, pcg6
         return;
     }
 
-    read_makers[hap].re_read<U>(hap_chrom_seq, chr, fastq_pools, eng);
+    read_makers[hap].re_read<U>(*hap_chrom_seq, chr, fastq_pools, eng);
 
     if (n_reads_vc[hap][chr] > 0) n_reads_vc[hap][chr]--;
 
@@ -620,11 +581,8 @@ void pacbio_ref_cpp(SEXP ref_genome_ptr,
                             prob_ins, prob_del, prob_subst);
     }
 
-    // For doing multithreaded compression after initial uncompressed run:
-    uint64 prog_n = n_reads;
-    if (compress > 0 && n_threads > 1) prog_n += (n_reads / 2);
     // Progress bar:
-    Progress prog_bar(prog_n, show_progress);
+    Progress prog_bar(n_reads, show_progress);
 
     write_reads_cpp_<PacBioReference>(
         read_filler_base, out_prefix, n_reads, prob_dup, read_pool_size, 1,
@@ -668,7 +626,8 @@ void pacbio_hap_cpp(SEXP hap_set_ptr,
                     const double& prob_thresh,
                     const double& prob_ins,
                     const double& prob_del,
-                    const double& prob_subst) {
+                    const double& prob_subst,
+                    const uint64& hap_cache_bytes) {
 
     XPtr<HapSet> hap_set(hap_set_ptr);
     PacBioHaplotypes read_filler_base;
@@ -679,21 +638,18 @@ void pacbio_hap_cpp(SEXP hap_set_ptr,
                            scale, sigma, loc, min_read_len,
                            max_passes, chi2_params_n, chi2_params_s,
                            sqrt_params, norm_params, prob_thresh,
-                           prob_ins, prob_del, prob_subst);
+                           prob_ins, prob_del, prob_subst, hap_cache_bytes);
     } else {
         read_filler_base =
             PacBioHaplotypes(*hap_set, haplotype_probs,
                            read_probs, read_lens,
                            max_passes, chi2_params_n, chi2_params_s,
                            sqrt_params, norm_params, prob_thresh,
-                           prob_ins, prob_del, prob_subst);
+                           prob_ins, prob_del, prob_subst, hap_cache_bytes);
     }
 
-    // For doing multithreaded compression after initial uncompressed run:
-    uint64 prog_n = n_reads;
-    if (compress > 0 && n_threads > 1) prog_n += (n_reads / 2);
     // Progress bar:
-    Progress prog_bar(prog_n, show_progress);
+    Progress prog_bar(n_reads, show_progress);
 
     if (sep_files) {
 
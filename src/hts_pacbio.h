@@ -21,6 +21,7 @@
 #include "jackalope_types.h"  // uint64
 #include "ref_classes.h"  // Ref* classes
 #include "hap_classes.h"  // Hap* classes
+#include "hap_cache.h"  // HapChromCache
 #include "pcg.h"  // runif_01
 #include "alias_sampler.h"  // AliasSampler
 #include "util.h"  // clear_memory
@@ -95,6 +96,12 @@ public:
 
     uint64 sample(pcg64& eng);
 
+    // Reset distribution so that output only depends on the RNG that follows:
+    void reset() {
+        distr.reset();
+        return;
+    }
+
 private:
 
     std::vector<uint64> read_lens;      // optional vector of possible read lengths
@@ -204,6 +211,12 @@ public:
 
     }
 
+    // Reset distribution so that output only depends on the RNG that follows:
+    void reset() {
+        distr.reset();
+        return;
+    }
+
 private:
 
     std::chi_squared_distribution<double> distr=std::chi_squared_distribution<double>(1);
@@ -491,7 +504,8 @@ public:
           chrom_reads(other.chrom_reads),
           chrom_lengths(other.chrom_lengths),
           chromosomes(other.chromosomes),
-          name(other.name) {};
+          name(other.name),
+          read_blocks(other.read_blocks) {};
 
 
 
@@ -499,7 +513,25 @@ public:
 
         std::vector<double> probs_(chrom_lengths.begin(), chrom_lengths.end());
         chrom_reads = reads_per_group(n_reads, probs_);
+        read_blocks.set(chrom_reads);
+
+        return;
+    }
+
+    /*
+     Only make reads from index `begin` to `begin + n - 1` (among all reads
+     from `add_n_reads`) until this is called again.
+     */
+    void set_block(const uint64& begin, const uint64& n) {
+        read_blocks.fill(chrom_reads, begin, n);
+        reset_distr();
+        return;
+    }
 
+    // Reset distributions so that output only depends on the RNG that follows:
+    void reset_distr() {
+        len_sampler.reset();
+        pass_sampler.reset();
         return;
     }
 
@@ -531,6 +563,12 @@ private:
     char qual_right = '!';
     uint64 read_chrom_space = 1;
     std::string read = std::string(1000, 'N');
+    // Read with errors added:
+    std::string read_out = std::string();
+    // Writes reads to FASTQ pools:
+    FastqEncoder fq_encoder = FastqEncoder();
+    // Splits reads from `add_n_reads` into blocks:
+    ReadBlocks read_blocks = ReadBlocks();
     // Maps nucleotide char to integer from 0 to 3
     std::vector<uint8> nt_map = sequencer::nt_map;
     /*
@@ -592,14 +630,17 @@ public:
                    const double& prob_thresh_,
                    const double& prob_ins_,
                    const double& prob_del_,
-                   const double& prob_subst_)
+                   const double& prob_subst_,
+                   const uint64& cache_bytes = jlp::hap_cache_bytes)
         : haplotypes(&hap_set),
           n_reads_vc(),
           read_makers(),
           hap_probs(haplotype_probs),
           hap(0),
           chr(0),
-          hap_chrom_seq() {
+          hap_chrom_seq(),
+          chrom_cache(std::make_shared<HapChromCache>(hap_set, cache_bytes)),
+          read_blocks() {
 
         /*
          Fill `read_makers` field:
@@ -630,14 +671,17 @@ public:
                    const double& prob_thresh_,
                    const double& prob_ins_,
                    const double& prob_del_,
-                   const double& prob_subst_)
+                   const double& prob_subst_,
+                   const uint64& cache_bytes = jlp::hap_cache_bytes)
         : haplotypes(&hap_set),
           n_reads_vc(),
           read_makers(),
           hap_probs(haplotype_probs),
           hap(0),
           chr(0),
-          hap_chrom_seq() {
+          hap_chrom_seq(),
+          chrom_cache(std::make_shared<HapChromCache>(hap_set, cache_bytes)),
+          read_blocks() {
 
         /*
          Fill `read_makers` field:
@@ -664,7 +708,9 @@ public:
           hap_probs(other.hap_probs),
           hap(other.hap),
           chr(other.chr),
-          hap_chrom_seq(other.hap_chrom_seq) {};
+          hap_chrom_seq(other.hap_chrom_seq),
+          chrom_cache(other.chrom_cache),
+          read_blocks(other.read_blocks) {};
 
 
     // Add info on # reads
@@ -675,6 +721,7 @@ public:
         // split # reads by haplotype
         std::vector<uint64> hap_reads = reads_per_group(n_reads, hap_probs);
         // splitting by chromosome, too:
+        n_reads_vc.clear();
         for (uint64 v = 0; v < n_haps; v++) {
             std::vector<double> chrom_probs;
             for (const HapChrom& vc : (*haplotypes)[v].chromosomes) {
@@ -682,6 +729,7 @@ public:
             }
             n_reads_vc.push_back(reads_per_group(hap_reads[v], chrom_probs));
         }
+        read_blocks.set(n_reads_vc);
 
         // Fill `read_makers` field:
         for (uint64 i = 0; i < n_haps; i++) {
@@ -693,6 +741,23 @@ public:
 
 
 
+    /*
+     Only make reads from index `begin` to `begin + n - 1` (among all reads
+     from `add_n_reads`) until this is called again.
+     */
+    void set_block(const uint64& begin, const uint64& n) {
+        read_blocks.fill(n_reads_vc, begin, n);
+        uint64 new_hap = haplotypes->size();
+        uint64 new_chr = 0;
+        read_blocks.first_group(new_hap, new_chr);
+        if (new_hap != hap || new_chr != chr) hap_chrom_seq.reset();
+        hap = new_hap;
+        chr = new_chr;
+        for (PacBioOneHaplotype& rm : read_makers) rm.reset_distr();
+        return;
+    }
+
+
     // `one_read` method
     template <typename U>
     void one_read(std::vector<U>& fastq_pools, bool& finished, pcg64& eng);
@@ -709,7 +774,11 @@ private:
     // Chromosome to create read from.
     uint64 chr;
     // String for haplotype chromosome. It's saved to make things faster.
-    std::string hap_chrom_seq;
+    HapChromCache::SeqPtr hap_chrom_seq;
+    // Full chromosome sequences, shared among copies of this object (i.e., threads):
+    std::shared_ptr<HapChromCache> chrom_cache;
+    // Splits reads from `add_n_reads` into blocks:
+    ReadBlocks read_blocks;
 
 
 };
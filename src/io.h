@@ -12,6 +12,12 @@
 #include <string>               // string class
 
 #include <fstream>
+#include <algorithm>  // min, max
+#include <deque>  // deque class
+#include <memory>  // shared_ptr, make_shared
+#include <thread>  // thread (for FileGZPar)
+#include <mutex>  // mutex, lock_guard, unique_lock
+#include <condition_variable>  // condition_variable
 #include "zlib.h"
 
 
@@ -86,8 +92,26 @@ struct FileBGZF {
 
         return;
     }
+    void set(const std::string& out_prefix,
+             const int& n_threads,
+             const int& compress) {
 
+        construct(out_prefix, compress);
 
+        if (n_threads > 1) bgzf_mt(file, n_threads, 256);
+
+        return;
+    }
+
+
+    /*
+     Included for compatibility with `FileBGZFBlocks`, where this compresses
+     `buffer` before `write`. Here, it does nothing.
+     */
+    inline bool prepare(std::vector<char>& buffer,
+                        std::vector<char>& scratch) const {
+        return true;
+    }
     inline void write(void *buffer, const int& c) {
         code = bgzf_write(file, buffer, c);
         return;
@@ -134,6 +158,117 @@ private:
 
 };
 
+/*
+ BGZF file where compression happens in the threads that create content.
+ Before being passed to `write`, each buffer is compressed into independent
+ BGZF blocks by `prepare`, which can run in many threads at once.
+ `write` then only has to write these blocks to the file, and `close`
+ adds the BGZF end-of-file marker.
+ Since blocks are independent, concatenating them makes a valid BGZF file.
+ */
+struct FileBGZFBlocks {
+
+    std::ofstream file;
+
+    FileBGZFBlocks() : file(), compress(-1) {};
+
+    FileBGZFBlocks(const std::string& out_prefix,
+                   const int& compress_) {
+        construct(out_prefix, compress_);
+    }
+
+    // Allows to set after initializing blank
+    void set(const std::string& out_prefix,
+             const int& compress_) {
+        construct(out_prefix, compress_);
+        return;
+    }
+    /*
+     The n_threads argument is added here for compatibility with templates that
+     allow multithreaded compression.
+     */
+    void set(const std::string& out_prefix,
+             const int& n_threads,
+             const int& compress_) {
+        construct(out_prefix, compress_);
+        return;
+    }
+
+    /*
+     Compress `buffer` into BGZF blocks, using `scratch` as working space.
+     Afterward, `buffer` contains the compressed blocks, and `scratch` contains
+     the original contents.
+     This only reads from this object, so it's safe to call from multiple threads.
+     (For that same reason, it returns `false` on failure instead of throwing
+     an error.)
+     */
+    bool prepare(std::vector<char>& buffer,
+                 std::vector<char>& scratch) const {
+        uint64 n_blocks = (buffer.size() + BGZF_BLOCK_SIZE - 1) / BGZF_BLOCK_SIZE;
+        scratch.resize(n_blocks * BGZF_MAX_BLOCK_SIZE);
+        uint64 in_pos = 0;
+        uint64 out_pos = 0;
+        while (in_pos < buffer.size()) {
+            size_t in_size = std::min(static_cast<uint64>(BGZF_BLOCK_SIZE),
+                                      buffer.size() - in_pos);
+            size_t out_size = BGZF_MAX_BLOCK_SIZE;
+            int code = bgzf_compress(&scratch[out_pos], &out_size,
+                                     &buffer[in_pos], in_size, compress);
+            if (code != 0) return false;
+            in_pos += in_size;
+            out_pos += out_size;
+        }
+        scratch.resize(out_pos);
+        buffer.swap(scratch);
+        return true;
+    }
+
+    inline void write(const std::vector<char>& buffer) {
+        file.write(buffer.data(), buffer.size());
+        return;
+    }
+
+    int close() {
+        // Empty BGZF block that marks the end of the file:
+        const char eof_block[28] = {
+            '\037', '\213', '\010', '\4', '\0', '\0', '\0', '\0', '\0', '\377',
+            '\6', '\0', '\102', '\103', '\2', '\0', '\033', '\0', '\3', '\0',
+            '\0', '\0', '\0', '\0', '\0', '\0', '\0', '\0'};
+        file.write(eof_block, 28);
+        file.close();
+        if (file.fail()) {
+            str_warn({"Close failed for BGZF file."});
+            return -1;
+        }
+        return 0;
+    }
+
+
+private:
+
+    int compress;
+
+    void construct(const std::string& out_prefix,
+                   const int& compress_) {
+
+        if (compress_ < -1 || compress_ > 9) {
+            str_stop({"\nInvalid bgzip compress level of ",
+                     std::to_string(compress_),
+                     ". It must be in range [0,9]."});
+        }
+        compress = compress_;
+
+        std::string file_name = out_prefix + ".gz";
+        file.open(file_name, std::ofstream::out | std::ios::binary);
+        if (!file.is_open()) {
+            str_stop({"\nIn bgzip step, it can't create ", out_prefix, ".gz"});
+        }
+
+        return;
+    }
+
+};
+
 // Simple wrapper around gzfile class to have `write` and `close` methods
 struct FileGZ {
 
@@ -146,6 +281,17 @@ struct FileGZ {
 
         construct(out_prefix, compress);
 
+    }
+    /*
+     The n_threads argument is added here for compatibility with templates that
+     allow multithreaded compression.
+     */
+    FileGZ(const std::string& out_prefix,
+           const int& n_threads,
+           const int& compress) {
+
+        construct(out_prefix, compress);
+
     }
 
     // Allows to set after initializing blank
@@ -154,8 +300,22 @@ struct FileGZ {
         construct(out_prefix, compress);
         return;
     }
+    void set(const std::string& out_prefix,
+             const int& n_threads,
+             const int& compress) {
+        construct(out_prefix, compress);
+        return;
+    }
 
 
+    /*
+     Included for compatibility with `FileBGZFBlocks`, where this compresses
+     `buffer` before `write`. Here, it does nothing.
+     */
+    inline bool prepare(std::vector<char>& buffer,
+                        std::vector<char>& scratch) const {
+        return true;
+    }
     inline void write(const std::vector<char>& buffer) {
         code = gzwrite(file, buffer.data(), buffer.size());
         return;
@@ -237,6 +397,304 @@ private:
 
 
 
+namespace jlp {
+    // Size of uncompressed chunks for `FileGZPar` (same as `pigz` default):
+    const uint64 gz_chunk_size = 131072;
+    // Size of dictionary (i.e., the deflate window) used for each chunk:
+    const uint64 gz_dict_size = 32768;
+}
+
+/*
+ gzip file compressed using multiple threads, in the same way as `pigz`.
+ Content passed to `write` is split into chunks, which are compressed
+ independently by `n_threads` threads.
+ Each chunk is compressed as raw deflate data ending at a byte boundary
+ (using `Z_SYNC_FLUSH`), and using the end of the previous chunk as its
+ dictionary.
+ Chunks are written in order, so they make up a single gzip member, and
+ the CRC for the whole file is computed by combining CRCs for chunks
+ (using `crc32_combine`).
+ The output is a normal gzip file, not BGZF.
+
+ `write` and `close` should only be called from one thread at a time.
+ */
+struct FileGZPar {
+
+    std::ofstream file;
+
+    FileGZPar()
+        : file(), compress(-1), n_threads(1), crc(0), total_size(0), failed(false),
+          pending(std::make_shared<Chunk>()), to_write(), to_compress(),
+          stopping(false), threads(), mtx(), cv_compress(), cv_done() {};
+
+    FileGZPar(const std::string& out_prefix,
+              const int& compress_) : FileGZPar() {
+        construct(out_prefix, 1, compress_);
+    }
+    FileGZPar(const std::string& out_prefix,
+              const int& n_threads_,
+              const int& compress_) : FileGZPar() {
+        construct(out_prefix, n_threads_, compress_);
+    }
+
+    FileGZPar(const FileGZPar&) = delete;
+    FileGZPar& operator=(const FileGZPar&) = delete;
+
+    ~FileGZPar() {
+        stop_threads__();
+    }
+
+    // Allows to set after initializing blank
+    void set(const std::string& out_prefix,
+             const int& compress_) {
+        construct(out_prefix, 1, compress_);
+        return;
+    }
+    void set(const std::string& out_prefix,
+             const int& n_threads_,
+             const int& compress_) {
+        construct(out_prefix, n_threads_, compress_);
+        return;
+    }
+
+    /*
+     Included for compatibility with `FileBGZFBlocks`.
+     Compression happens inside this object, so it does nothing here.
+     */
+    inline bool prepare(std::vector<char>& buffer,
+                        std::vector<char>& scratch) const {
+        return true;
+    }
+
+    inline void write(const std::vector<char>& buffer) {
+        write(buffer.data(), buffer.size());
+        return;
+    }
+    inline void write(const std::string& buffer) {
+        write(buffer.data(), buffer.size());
+        return;
+    }
+    void write(const char* data, uint64 size) {
+        while (size > 0) {
+            uint64 n = std::min(size, jlp::gz_chunk_size - pending->input.size());
+            pending->input.append(data, n);
+            data += n;
+            size -= n;
+            if (pending->input.size() == jlp::gz_chunk_size) submit__();
+        }
+        return;
+    }
+
+    int close() {
+
+        if (!pending->input.empty()) submit__();
+        write_chunks__(0);
+        stop_threads__();
+
+        // Empty, final deflate block, followed by the gzip trailer:
+        char trailer[10] = {'\3', '\0'};
+        for (uint32 i = 0; i < 4; i++) {
+            trailer[2+i] = static_cast<char>((crc >> (8 * i)) & 0xff);
+            trailer[6+i] = static_cast<char>((total_size >> (8 * i)) & 0xff);
+        }
+        file.write(trailer, 10);
+        file.close();
+
+        if (failed || file.fail()) {
+            str_warn({"Compression or close failed for gzip file."});
+            return -1;
+        }
+        return 0;
+    }
+
+
+private:
+
+    struct Chunk {
+        std::string dict;    // end of previous chunk
+        std::string input;
+        std::string output;
+        uLong crc;
+        bool done;
+        Chunk() : dict(), input(), output(), crc(0), done(false) {};
+    };
+
+    int compress;
+    uint64 n_threads;
+    uLong crc;
+    uint64 total_size;
+    bool failed;
+    std::shared_ptr<Chunk> pending;
+    // Chunks waiting to be written (in order) and compressed (in any order):
+    std::deque<std::shared_ptr<Chunk>> to_write;
+    std::deque<std::shared_ptr<Chunk>> to_compress;
+    bool stopping;
+    std::vector<std::thread> threads;
+    std::mutex mtx;
+    std::condition_variable cv_compress;
+    std::condition_variable cv_done;
+
+
+    void construct(const std::string& out_prefix,
+                   const int& n_threads_,
+                   const int& compress_) {
+
+        if (compress_ < -1 || compress_ > 9) {
+            str_stop({"\nInvalid gzip compress level of ",
+                     std::to_string(compress_),
+                     ". It must be in range [0,9]."});
+        }
+        compress = compress_;
+        n_threads = std::max(n_threads_, 1);
+        crc = crc32(0L, Z_NULL, 0);
+        total_size = 0;
+        failed = false;
+        pending = std::make_shared<Chunk>();
+        pending->input.reserve(jlp::gz_chunk_size);
+        stopping = false;
+
+        std::string file_name = out_prefix + ".gz";
+        file.open(file_name, std::ofstream::out | std::ios::binary);
+        if (!file.is_open()) {
+            str_stop({"\nUnable to create ", out_prefix, ".gz"});
+        }
+
+        // gzip header (no file name or time stamp; OS is unknown):
+        const char header[10] = {'\037', '\213', '\010', '\0', '\0',
+                                 '\0', '\0', '\0', '\0', '\377'};
+        file.write(header, 10);
+
+        // With one thread, chunks are compressed in `submit__`:
+        if (n_threads > 1) {
+            for (uint64 i = 0; i < n_threads; i++) {
+                threads.push_back(std::thread(&FileGZPar::compress_loop__, this));
+            }
+        }
+
+        return;
+    }
+
+    // Compress one chunk (returns false if it failed)
+    static bool compress_chunk__(Chunk& chunk, const int& level) {
+
+        chunk.crc = crc32(crc32(0L, Z_NULL, 0),
+                          reinterpret_cast<const Bytef*>(chunk.input.data()),
+                          chunk.input.size());
+
+        z_stream strm;
+        strm.zalloc = Z_NULL;
+        strm.zfree = Z_NULL;
+        strm.opaque = Z_NULL;
+        // Negative window bits for raw deflate (i.e., no zlib header or trailer):
+        if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK) return false;
+        if (!chunk.dict.empty()) {
+            deflateSetDictionary(
+                &strm, reinterpret_cast<const Bytef*>(chunk.dict.data()),
+                chunk.dict.size());
+        }
+        chunk.output.resize(deflateBound(&strm, chunk.input.size()) + 16);
+        strm.next_in = reinterpret_cast<Bytef*>(&chunk.input[0]);
+        strm.avail_in = chunk.input.size();
+        strm.next_out = reinterpret_cast<Bytef*>(&chunk.output[0]);
+        strm.avail_out = chunk.output.size();
+        int code = deflate(&strm, Z_SYNC_FLUSH);
+        bool success = code == Z_OK && strm.avail_in == 0 && strm.avail_out > 0;
+        chunk.output.resize(chunk.output.size() - strm.avail_out);
+        deflateEnd(&strm);
+
+        return success;
+    }
+
+    void compress_loop__() {
+        while (true) {
+            std::shared_ptr<Chunk> chunk;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_compress.wait(lock, [this]() {
+                    return !to_compress.empty() || stopping;
+                });
+                if (to_compress.empty()) return;
+                chunk = to_compress.front();
+                to_compress.pop_front();
+            }
+            bool success = compress_chunk__(*chunk, compress);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!success) failed = true;
+                chunk->done = true;
+            }
+            cv_done.notify_all();
+        }
+        return;
+    }
+
+    // Pass `pending` chunk off to be compressed, and start a new one
+    void submit__() {
+
+        std::shared_ptr<Chunk> next = std::make_shared<Chunk>();
+        uint64 n_dict = std::min(jlp::gz_dict_size, pending->input.size());
+        next->dict.assign(pending->input, pending->input.size() - n_dict, n_dict);
+        next->input.reserve(jlp::gz_chunk_size);
+
+        if (n_threads == 1) {
+            if (!compress_chunk__(*pending, compress)) failed = true;
+            pending->done = true;
+            to_write.push_back(pending);
+        } else {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                to_write.push_back(pending);
+                to_compress.push_back(pending);
+            }
+            cv_compress.notify_one();
+        }
+        pending = next;
+
+        // Write what's finished, and keep the # chunks in memory limited:
+        write_chunks__(2 * n_threads);
+
+        return;
+    }
+
+    /*
+     Write compressed chunks in order, waiting for them to finish compressing
+     until at most `max_left` are left.
+     */
+    void write_chunks__(const uint64& max_left) {
+        while (!to_write.empty()) {
+            std::shared_ptr<Chunk> chunk = to_write.front();
+            if (to_write.size() > max_left) {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_done.wait(lock, [&chunk]() { return chunk->done; });
+            } else {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!chunk->done) break;
+            }
+            file.write(chunk->output.data(), chunk->output.size());
+            crc = crc32_combine(crc, chunk->crc, chunk->input.size());
+            total_size += chunk->input.size();
+            to_write.pop_front();
+        }
+        return;
+    }
+
+    void stop_threads__() {
+        if (threads.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv_compress.notify_all();
+        for (std::thread& t : threads) t.join();
+        threads.clear();
+        return;
+    }
+
+};
+
+
+
 // Simple wrapper around std::ofstream class to have `write` and `close` methods
 // that are exactly the same as FileGZ and FileBGZF above
 struct FileUncomp {
@@ -249,13 +707,18 @@ struct FileUncomp {
         construct(file_name);
     }
     /*
-     The compress argument is added here for compatibility with templates that
-     allow compressed-file classes.
+     The compress and n_threads arguments are added here for compatibility with
+     templates that allow compressed-file classes.
      */
     FileUncomp(const std::string& file_name,
                const int& compress) {
         construct(file_name);
     }
+    FileUncomp(const std::string& file_name,
+               const int& n_threads,
+               const int& compress) {
+        construct(file_name);
+    }
 
     // Allows to set after initializing blank
     void set(const std::string& file_name,
@@ -263,7 +726,21 @@ struct FileUncomp {
         construct(file_name);
         return;
     }
+    void set(const std::string& file_name,
+             const int& n_threads,
+             const int& compress) {
+        construct(file_name);
+        return;
+    }
 
+    /*
+     Included for compatibility with `FileBGZFBlocks`, where this compresses
+     `buffer` before `write`. Here, it does nothing.
+     */
+    inline bool prepare(std::vector<char>& buffer,
+                        std::vector<char>& scratch) const {
+        return true;
+    }
     inline void write(const std::vector<char>& buffer) {
         file.write(buffer.data(), buffer.size());
         return;
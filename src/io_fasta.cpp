@@ -425,16 +425,18 @@ SEXP read_fasta_ind(const std::vector<std::string>& fasta_files,
 /*
  Template that does most of the work to write from RefGenome to FASTA files of
  varying formats (gzip, bgzip, uncompressed).
- `T` should be `FileUncomp` or `FileBGZF` from `io.h`
+ `T` should be `FileUncomp`, `FileGZ`, `FileGZPar`, or `FileBGZF` from `io.h`.
+ `n_threads` is only used for compression.
  */
 template <typename T>
 inline void write_ref_fasta__(const std::string& file_name,
                               const int& compress,
                               const RefGenome& ref,
                               const uint64& text_width,
+                              const int& n_threads,
                               const bool& show_progress) {
 
-    T file(file_name, compress);
+    T file(file_name, n_threads, compress);
 
     Progress prog_bar(ref.total_size, show_progress);
 
@@ -488,6 +490,7 @@ inline void write_ref_fasta__(const std::string& file_name,
 //' @param ref_genome_ptr An external pointer to a \code{RefGenome} C++ object.
 //' @param text_width The number of characters per line in the output fasta file.
 //' @param compress Boolean for whether to compress output.
+//' @param n_threads Number of threads to use for compression.
 //'
 //' @return Nothing.
 //'
@@ -500,28 +503,35 @@ void write_ref_fasta(const std::string& out_prefix,
                      const uint64& text_width,
                      const int& compress,
                      const std::string& comp_method,
+                     uint64 n_threads,
                      const bool& show_progress) {
 
     XPtr<RefGenome> ref_xptr(ref_genome_ptr);
     RefGenome& ref(*ref_xptr);
 
+    // Check that # threads isn't too high and change to 1 if not using OpenMP
+    thread_check(n_threads);
+
     std::string file_name = out_prefix + ".fa";
 
     expand_path(file_name);
 
     if (compress > 0) {
 
-        if (comp_method == "gzip") {
+        if (comp_method == "gzip" && n_threads > 1) {
+            write_ref_fasta__<FileGZPar>(file_name, compress, ref, text_width,
+                                         n_threads, show_progress);
+        } else if (comp_method == "gzip") {
             write_ref_fasta__<FileGZ>(file_name, compress, ref, text_width,
-                                      show_progress);
+                                      n_threads, show_progress);
         } else if (comp_method == "bgzip") {
             write_ref_fasta__<FileBGZF>(file_name, compress, ref, text_width,
-                                        show_progress);
+                                        n_threads, show_progress);
         } else stop("\nUnrecognized compression method.");
 
     } else {
         write_ref_fasta__<FileUncomp>(file_name, compress, ref, text_width,
-                                      show_progress);
+                                      n_threads, show_progress);
     }
 
     return;
@@ -532,6 +542,11 @@ void write_ref_fasta(const std::string& out_prefix,
 
 
 
+/*
+ Threads are split among haplotypes (one file each).
+ If there are more threads than haplotypes, the extra threads are used to
+ compress each file.
+ */
 template <typename T>
 void write_haps_fasta__(const std::string& out_prefix,
                         const HapSet& hap_set,
@@ -540,8 +555,20 @@ void write_haps_fasta__(const std::string& out_prefix,
                         const uint64& n_threads,
                         const bool& show_progress) {
 
+    int comp_threads = 1;
+    if (hap_set.size() > 0 && n_threads > hap_set.size()) {
+        comp_threads = n_threads / hap_set.size();
+    }
+
     Progress prog_bar(hap_set.reference->size() * hap_set.size(), show_progress);
 
+    // Write largest haplotypes first:
+    std::vector<uint64> sizes(hap_set.size());
+    for (uint64 v = 0; v < hap_set.size(); v++) {
+        for (const uint64& n : hap_set[v].chrom_sizes()) sizes[v] += n;
+    }
+    const std::vector<uint64> order = cost_order(sizes);
+
 #ifdef _OPENMP
 #pragma omp parallel num_threads(n_threads) if (n_threads > 1)
 {
@@ -553,14 +580,16 @@ void write_haps_fasta__(const std::string& out_prefix,
 
     // Parallelize the Loop
 #ifdef _OPENMP
-#pragma omp for schedule(static)
+#pragma omp for schedule(dynamic)
 #endif
-    for (uint64 v = 0; v < hap_set.size(); v++) {
+    for (uint64 k = 0; k < hap_set.size(); k++) {
 
         if (prog_bar.is_aborted() || prog_bar.check_abort()) continue;
 
+        const uint64& v(order[k]);
+
         std::string file_name = out_prefix + "__" + hap_set[v].name + ".fa";
-        T out_file(file_name, compress);
+        T out_file(file_name, comp_threads, compress);
 
         for (uint64 s = 0; s < hap_set.reference->size(); s++) {
 
@@ -637,7 +666,10 @@ void write_haps_fasta(std::string out_prefix,
 
     if (compress > 0) {
 
-        if (comp_method == "gzip") {
+        if (comp_method == "gzip" && n_threads > hap_set.size()) {
+            write_haps_fasta__<FileGZPar>(out_prefix, hap_set, text_width, compress,
+                                          n_threads, show_progress);
+        } else if (comp_method == "gzip") {
             write_haps_fasta__<FileGZ>(out_prefix, hap_set, text_width, compress,
                                        n_threads, show_progress);
         } else if (comp_method == "bgzip") {
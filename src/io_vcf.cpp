@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <utility>  // pair
 #include "zlib.h"
 #ifdef _OPENMP
 #include <omp.h>  // omp
@@ -22,7 +23,7 @@
 #include "ref_classes.h"  // Ref* classes
 #include "hap_classes.h"  // Hap* classes
 #include "str_manip.h"  // filter_nucleos, cpp_str_split_delim_str, count_substr
-#include "util.h"  // str_stop, thread_check
+#include "util.h"  // str_stop, thread_check, cost_order
 #include "io.h"
 #include "io_vcf.h"
 #include "htslib/vcf.h"
@@ -79,8 +80,8 @@ void OneHapChromVCF::check(const uint64& pos_start,
         if (mut_ind.second < (hap_chrom->mutations.size() - 1) &&
             hap_chrom->size_modifier(mut_ind.second) >= 0) {
             if (hap_chrom->size_modifier(mut_ind.second + 1) < 0 &&
-                hap_chrom->mutations.old_pos[mut_ind.second + 1] ==
-                (hap_chrom->mutations.old_pos[mut_ind.second] + 1)) {
+                hap_chrom->mutations.old_pos(mut_ind.second + 1) ==
+                (hap_chrom->mutations.old_pos(mut_ind.second) + 1)) {
                 mut_ind.second++;
             }
         }
@@ -127,7 +128,7 @@ void OneHapChromVCF::dump(std::vector<std::string>& unq_alts,
         uint64 n_muts = mut_ind.second - mut_ind.first + 1;
         for (uint64 i = 0; i < n_muts; i++) {
             uint64 index = mut_ind.second - i;
-            pos = mutations.old_pos[index] - pos_start;
+            pos = mutations.old_pos(index) - pos_start;
             if (pos >= alt_str.size()) {
                 stop(std::string("\nPosition ") + std::to_string(pos) +
                     std::string(" on alt. string is too high for total ") +
@@ -135,10 +136,10 @@ void OneHapChromVCF::dump(std::vector<std::string>& unq_alts,
                     std::to_string(alt_str.size()));
             }
             if (hap_chrom->size_modifier(index) == 0) { // substitution
-                alt_str[pos] = mutations.nucleos[index][0];
+                alt_str[pos] = mutations.get_nucleo(index, 0);
             } else if (hap_chrom->size_modifier(index) > 0) { // insertion
                 // Copy so we can remove last nucleotide before inserting:
-                std::string nts(mutations.nucleos[index]);
+                std::string nts = mutations.get_nucleos(index);
                 alt_str[pos] = nts.back();
                 nts.pop_back();
                 alt_str.insert(pos, nts);  // inserts before `pos`
@@ -511,8 +512,108 @@ int fill_vcf_info(const std::string& fn,
 
 
 
+/*
+ Make a batch of mutations for one haplotype and chromosome based on VCF-file
+ info vectors.
+ `records` are indices to the records for this chromosome, in the order they're in
+ the file.
+ It returns false if positions aren't in increasing order.
+ */
+bool make_vcf_batch(std::vector<RefMutation>& batch,
+                    std::string& seqs,
+                    const uint64& hap_i,
+                    const std::vector<uint64>& records,
+                    const std::vector<std::vector<std::string>>& alts_list,
+                    const std::vector<uint64>& positions,
+                    const std::vector<std::string>& ref_chrom) {
+
+    batch.clear();
+    seqs.clear();
+
+    for (const uint64& mut_i : records) {
+
+        const std::string& ref(ref_chrom[mut_i]);
+        const std::string& alt(alts_list[mut_i][hap_i]);
+        const uint64& pos(positions[mut_i]);
+
+        // If it's blank or if it's the same as the reference, move on:
+        if (alt.size() == 0 || alt == ref) continue;
+
+        // Make sure that positions are never before any existing mutations
+        if (!batch.empty() && batch.back().pos >= pos) return false;
+
+        if (alt.size() == ref.size()) {
+            /*
+             ------------
+             substitution(s)
+             ------------
+             */
+            for (uint64 i = 0; i < ref.size(); i++) {
+                if (alt[i] != ref[i]) {
+                    batch.push_back(RefMutation(pos + i, 0, seqs.size()));
+                    seqs.push_back(alt[i]);
+                }
+            }
+        } else if (alt.size() > ref.size()) {
+            /*
+             ------------
+             insertion
+             ------------
+             */
+            /*
+             For all chromosomes but the last in the REF string, just make
+             them substitutions if they differ from ALT.
+             */
+            uint64 i = 0;
+            for (; i < (ref.size()-1); i++) {
+                if (alt[i] != ref[i]) {
+                    batch.push_back(RefMutation(pos + i, 0, seqs.size()));
+                    seqs.push_back(alt[i]);
+                }
+            }
+            /*
+             Make the last one an insertion proper, using the rest of ALT
+             */
+            sint64 size_mod_i = alt.size() - ref.size();
+            batch.push_back(RefMutation(pos + i, size_mod_i, seqs.size()));
+            seqs.append(alt, i, std::string::npos);
+
+        } else {
+            /*
+             ------------
+             deletion
+             ------------
+             */
+            /*
+             For all chromosomes in the ALT string, just make them substitutions
+             if they differ from REF.
+             (Note that this goes to the end of ALT, not REF, as it does for
+             insertions.)
+             */
+            uint64 i = 0;
+            for (; i < alt.size(); i++) {
+                if (alt[i] != ref[i]) {
+                    batch.push_back(RefMutation(pos + i, 0, seqs.size()));
+                    seqs.push_back(alt[i]);
+                }
+            }
+
+            sint64 size_mod_i = static_cast<sint64>(alt.size()) -
+                static_cast<sint64>(ref.size());
+            batch.push_back(RefMutation(pos + i, size_mod_i, seqs.size()));
+
+        }
+
+    }
+
+    return true;
+}
+
+
 /*
  Add mutations to a HapSet object based on VCF-file info vectors.
+ Each haplotype's chromosome gets all its mutations in one batch, and these
+ are spread across threads.
  */
 
 void add_vcf_mutations(HapSet& hap_set,
@@ -520,123 +621,86 @@ void add_vcf_mutations(HapSet& hap_set,
                        const std::vector<uint64>& chrom_inds,
                        const std::vector<uint64>& positions,
                        const std::vector<std::string>& ref_chrom,
-                       const std::vector<uint64>& ind_map) {
+                       const std::vector<uint64>& ind_map,
+                       const uint64& n_threads) {
 
     uint64 n_muts = alts_list.size();
     uint64 n_haps = hap_set.size();
+    uint64 n_chroms = hap_set.reference->size();
 
-    arma::Mat<sint64> size_mods(n_haps, hap_set.reference->size(), arma::fill::zeros);
-
-    sint64 size_mod_i; // used temporarily for each deletion and insertion
-
-    uint64 new_pos;
-
+    // Records for each chromosome:
+    std::vector<std::vector<uint64>> chrom_records(n_chroms);
     for (uint64 mut_i = 0; mut_i < n_muts; mut_i++) {
+        chrom_records[ind_map[chrom_inds[mut_i]]].push_back(mut_i);
+    }
 
-        const std::string& ref(ref_chrom[mut_i]);
-        const std::vector<std::string>& alts(alts_list[mut_i]);
-        const uint64& chrom_i(ind_map[chrom_inds[mut_i]]);
+    /*
+     Tasks are chromosome and haplotype indices, done from most to least expensive.
+     */
+    std::vector<std::pair<uint64,uint64>> tasks;
+    std::vector<uint64> costs;
+    tasks.reserve(n_chroms * n_haps);
+    costs.reserve(n_chroms * n_haps);
+    for (uint64 i = 0; i < n_chroms; i++) {
+        for (uint64 j = 0; j < n_haps; j++) {
+            tasks.push_back(std::make_pair(i, j));
+            costs.push_back(chrom_records[i].size());
+        }
+    }
+    const std::vector<uint64> order = cost_order(costs);
 
-        for (uint64 hap_i = 0; hap_i < n_haps; hap_i++) {
+    // Set to 1 when positions aren't sorted:
+    std::vector<int> status_codes(n_threads, 0);
 
-            const std::string& alt(alts[hap_i]);
+#ifdef _OPENMP
+#pragma omp parallel default(shared) num_threads(n_threads) if (n_threads > 1)
+{
+#endif
 
-            // If it's blank or if it's the same as the reference, move on:
-            if (alt.size() == 0 || alt == ref) continue;
+    std::vector<RefMutation> batch;
+    std::string seqs;
+
+#ifdef _OPENMP
+    uint64 active_thread = omp_get_thread_num();
+#else
+    uint64 active_thread = 0;
+#endif
+    int& status_code(status_codes[active_thread]);
 
-            // Else, mutate accordingly:
-            HapChrom& hap_chrom(hap_set[hap_i][chrom_i]);
-            AllMutations& mutations(hap_chrom.mutations);
-            sint64& size_mod(size_mods(hap_i, chrom_i));
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (uint64 k = 0; k < tasks.size(); k++) {
 
-            // Make sure that positions are never before any existing mutations
-            if (!mutations.empty() && mutations.old_pos.back() >= positions[mut_i]) {
-                str_stop({"\nFor VCF files, \"Positions are sorted numerically, in ",
-                         "increasing order, within each reference sequence CHROM.\" ",
-                         "(VCFv4.3 specification). ",
-                         "In jackalope, multiple records with the same POS are also ",
-                         "not permitted"});
-            }
+        if (status_code != 0) continue;
 
-            if (alt.size() == ref.size()) {
-                /*
-                 ------------
-                 substitution(s)
-                 ------------
-                 */
-                for (uint64 i = 0; i < ref.size(); i++) {
-                    if (alt[i] != ref[i]) {
-                        new_pos = positions[mut_i] + i + size_mod;
-                        mutations.push_back(positions[mut_i] + i, new_pos, alt[i]);
-                    }
-                }
-            } else if (alt.size() > ref.size()) {
-                /*
-                 ------------
-                 insertion
-                 ------------
-                 */
-                // Copy the string so it can be manipulated
-                std::string alt_copy = alt;
-
-                /*
-                 For all chromosomes but the last in the REF string, just make
-                 them substitutions if they differ from ALT.
-                 */
-                uint64 i = 0;
-                for (; i < (ref.size()-1); i++) {
-                    if (alt[i] != ref[i]) {
-                        new_pos = positions[mut_i] + i + size_mod;
-                        mutations.push_back(positions[mut_i] + i, new_pos, alt_copy[i]);
-                    }
-                }
-                // Erase all the nucleotides that have already been added (if any):
-                if (ref.size() > 1) alt_copy.erase(0, ref.size() - 1U);
-                /*
-                 Make the last one an insertion proper
-                 */
-                size_mod_i = alt_copy.size() - 1;
-                new_pos = positions[mut_i] + i + size_mod;
-                mutations.push_back(positions[mut_i] + i, new_pos,
-                                    alt_copy.c_str());
-                size_mod += size_mod_i;
-                hap_chrom.chrom_size += size_mod_i;
+        const uint64& chrom_i(tasks[order[k]].first);
+        const uint64& hap_i(tasks[order[k]].second);
 
-            } else {
-                /*
-                 ------------
-                 deletion
-                 ------------
-                 */
-                /*
-                 For all chromosomes in the ALT string, just make them substitutions
-                 if they differ from REF.
-                 (Note that this goes to the end of ALT, not REF, as it does for
-                 insertions.)
-                 */
-                uint64 i = 0;
-                for (; i < alt.size(); i++) {
-                    if (alt[i] != ref[i]) {
-                        new_pos = positions[mut_i] + i + size_mod;
-                        mutations.push_back(positions[mut_i] + i, new_pos, alt[i]);
-                    }
-                }
+        if (!make_vcf_batch(batch, seqs, hap_i, chrom_records[chrom_i],
+                            alts_list, positions, ref_chrom)) {
+            status_code = 1;
+            continue;
+        }
 
-                size_mod_i = static_cast<sint64>(alt.size()) -
-                    static_cast<sint64>(ref.size());
+        if (!batch.empty()) hap_set[hap_i][chrom_i].add_ref_mutations(batch, seqs);
 
-                new_pos = positions[mut_i] + i + size_mod;
-                mutations.push_back(positions[mut_i] + i, new_pos, nullptr);
-                size_mod += size_mod_i;
-                hap_chrom.chrom_size += size_mod_i;
+    }
 
-            }
+#ifdef _OPENMP
+}
+#endif
 
+    for (const int& status_code : status_codes) {
+        if (status_code != 0) {
+            str_stop({"\nFor VCF files, \"Positions are sorted numerically, in ",
+                     "increasing order, within each reference sequence CHROM.\" ",
+                     "(VCFv4.3 specification). ",
+                     "In jackalope, multiple records with the same POS are also ",
+                     "not permitted"});
         }
-
     }
 
-
     return;
 }
 
@@ -647,7 +711,8 @@ void add_vcf_mutations(HapSet& hap_set,
 //[[Rcpp::export]]
 SEXP read_vcf_cpp(SEXP reference_ptr,
                   const std::string& fn,
-                  const bool& print_names) {
+                  const bool& print_names,
+                  uint64 n_threads) {
 
     /*
      ------------
@@ -694,6 +759,9 @@ SEXP read_vcf_cpp(SEXP reference_ptr,
      */
     XPtr<RefGenome> reference(reference_ptr);
 
+    // Check that # threads isn't too high and change to 1 if not using OpenMP:
+    thread_check(n_threads);
+
     // Verify that names in the VCF file match those in the reference genome
     if (chrom_names.size() != reference->size()) {
         str_stop({"\nThe number of chromosomes in the VCF file doesn't match ",
@@ -711,7 +779,8 @@ SEXP read_vcf_cpp(SEXP reference_ptr,
     // Finally create HapSet
     XPtr<HapSet> hap_set(new HapSet(*reference, hap_names));
     // ...and add mutations:
-    add_vcf_mutations(*hap_set, alts_list, chrom_inds, positions, ref_chrom, ind_map);
+    add_vcf_mutations(*hap_set, alts_list, chrom_inds, positions, ref_chrom, ind_map,
+                      n_threads);
 
     return hap_set;
 
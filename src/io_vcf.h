@@ -179,8 +179,8 @@ private:
             if (mut_ind.second < (hap_chrom->mutations.size()-1) &&
                 hap_chrom->size_modifier(mut_ind.first) >= 0) {
                 if (hap_chrom->size_modifier(mut_ind.second + 1) < 0 &&
-                    hap_chrom->mutations.old_pos[mut_ind.second + 1] ==
-                    (hap_chrom->mutations.old_pos[mut_ind.first] + 1)) {
+                    hap_chrom->mutations.old_pos(mut_ind.second + 1) ==
+                    (hap_chrom->mutations.old_pos(mut_ind.first) + 1)) {
                     mut_ind.second++;
                     index = mut_ind.second;
                 }
@@ -195,16 +195,16 @@ private:
      that deletions have to be treated differently
      */
     inline void set_first_pos(const uint64& index) {
-        ref_pos.first = hap_chrom->mutations.old_pos[index];
+        ref_pos.first = hap_chrom->mutations.old_pos(index);
         if (hap_chrom->size_modifier(index) < 0 &&
-            hap_chrom->mutations.old_pos[index] > 0) ref_pos.first--;
+            hap_chrom->mutations.old_pos(index) > 0) ref_pos.first--;
         return;
     }
     // Same as above, but returns the integer rather than setting it
     inline uint64 get_first_pos(const uint64& index) {
-        uint64 pos_first = hap_chrom->mutations.old_pos[index];
+        uint64 pos_first = hap_chrom->mutations.old_pos(index);
         if (hap_chrom->size_modifier(index) < 0 &&
-            hap_chrom->mutations.old_pos[index] > 0) pos_first--;
+            hap_chrom->mutations.old_pos(index) > 0) pos_first--;
         return pos_first;
     }
     /*
@@ -212,9 +212,9 @@ private:
      that deletions have to be treated differently
      */
     inline void set_second_pos(const uint64& index) {
-        ref_pos.second = hap_chrom->mutations.old_pos[index];
+        ref_pos.second = hap_chrom->mutations.old_pos(index);
         if (hap_chrom->size_modifier(index) < 0) {
-            if (hap_chrom->mutations.old_pos[index] > 0) {
+            if (hap_chrom->mutations.old_pos(index) > 0) {
                 ref_pos.second -= (1 + hap_chrom->size_modifier(index));
             } else {
                 ref_pos.second -= hap_chrom->size_modifier(index);
@@ -224,9 +224,9 @@ private:
     }
     // Same as above, but returns the integer rather than setting it
     inline uint64 get_second_pos(const uint64& index) {
-        uint64 pos_second = hap_chrom->mutations.old_pos[index];
+        uint64 pos_second = hap_chrom->mutations.old_pos(index);
         if (hap_chrom->size_modifier(index) < 0) {
-            if (hap_chrom->mutations.old_pos[index] > 0) {
+            if (hap_chrom->mutations.old_pos(index) > 0) {
                 pos_second -= (1 + hap_chrom->size_modifier(index));
             } else {
                 pos_second -= hap_chrom->size_modifier(index);
@@ -41,7 +41,7 @@ int TreeMutator::mutate(const double& b_len,
                         Progress& prog_bar,
                         const uint64& begin,
                         uint64& end,
-                        std::deque<uint8>& rate_inds)  {
+                        SiteRates& rate_inds)  {
 
 #ifdef __JACKALOPE_DEBUG
     if (end < begin) stop("end < begin in TreeMutator.mutate");
@@ -52,7 +52,7 @@ int TreeMutator::mutate(const double& b_len,
 
     status = indels.add_indels(b_len, begin, end, rate_inds, subs, hap_chrom,
                                eng, prog_bar);
-    if (status < 0) return status;
+    if (status != 0) return status;
 
     status = subs.add_subs(b_len, begin, end, rate_inds, hap_chrom, eng, prog_bar);
 
@@ -21,7 +21,7 @@
 #include "hap_classes.h"  // Hap* classes
 #include "pcg.h"  // pcg seeding
 #include "alias_sampler.h"  // alias method of sampling
-#include "mutator_subs.h"   // SubMutator
+#include "mutator_subs.h"   // SubMutator, SiteRates
 #include "mutator_indels.h" // IndelMutator
 #include "io.h"  // FileUncomp
 #include "util.h"  // str_stop
@@ -80,11 +80,11 @@ struct TreeMutator {
                Progress& prog_bar,
                const uint64& begin,
                uint64& end,
-               std::deque<uint8>& rate_inds);
+               SiteRates& rate_inds);
 
     int new_rates(const uint64& begin,
                   const uint64& end,
-                  std::deque<uint8>& rate_inds,
+                  SiteRates& rate_inds,
                   pcg64& eng,
                   Progress& prog_bar) {
         int status = subs.new_rates(begin, end, rate_inds, eng, prog_bar);
@@ -10,10 +10,12 @@
 #include <RcppArmadillo.h>
 #include <pcg/pcg_random.hpp> // pcg prng
 #include <progress.hpp>  // for the progress bar
-#include <cmath>  // pow
+#include <cmath>  // pow, log
 #include <vector>  // vector class
 #include <string>  // string class
 #include <random>  // poisson_distribution
+#include <algorithm>  // sort, min, max
+#include <utility>  // pair
 
 
 #include "mutator_indels.h"  // IndelMutator
@@ -26,70 +28,214 @@ using namespace Rcpp;
 
 
 
-// Add just one indel
-inline void IndelMutator::one_indel__(const double& change,
-                                      std::string& insert_str,
-                                      const uint64& begin,
-                                      uint64& end,
-                                      std::deque<uint8>& rate_inds,
-                                      SubMutator& subs,
-                                      HapChrom& hap_chrom,
-                                      pcg64& eng) {
-
-    if (change > 0) {
-        uint64 size = static_cast<uint64>(change);
-        uint64 pos = static_cast<uint64>(runif_01(eng) * (end - begin) + begin);
-        insert_str.clear();
-        for (uint32 j = 0; j < size; j++) insert_str += insert.sample(eng);
-        hap_chrom.add_insertion(insert_str, pos);
-        subs.insertion_adjust(size, pos, begin, rate_inds, eng);
-        end += size;
-    } else {
-        uint64 size = std::min(static_cast<uint64>(std::abs(change)),
-                               end - begin);
-        uint64 pos = static_cast<uint64>(runif_01(eng) *
-            (end - begin - size + 1) + begin);
-        hap_chrom.add_deletion(size, pos);
-        subs.deletion_adjust(size, pos, begin, rate_inds);
-        end -= size;
+/*
+ Convert segments to indels (starting at chromosome position `begin`) that, when
+ added in order, change the original sites to the current ones.
+ Removed original sites become deletions, and inserted segments become insertions.
+ Positions are where each indel goes after the ones before it have been added.
+ */
+void IndelSegments::to_indels(const uint64& begin, std::vector<Indel>& indels) const {
+
+    indels.clear();
+
+    // Segments in order:
+    std::vector<uint32> segs;
+    segs.reserve(nodes.size());
+    std::vector<uint32> stack;
+    uint32 t = root;
+    while (t != 0 || !stack.empty()) {
+        while (t != 0) {
+            stack.push_back(t);
+            t = nodes[t].left;
+        }
+        t = stack.back();
+        stack.pop_back();
+        segs.push_back(t);
+        t = nodes[t].right;
+    }
+
+    // Start of the next original segment after each one (or # original sites):
+    std::vector<uint64> next_orig(segs.size());
+    uint64 next = n_orig;
+    for (uint64 k = segs.size(); k > 0; k--) {
+        next_orig[k-1] = next;
+        if (!nodes[segs[k-1]].inserted) next = nodes[segs[k-1]].start;
     }
 
+    uint64 pos = begin;     // current position, after the indels so far
+    uint64 orig_next = 0;   // next original site that hasn't been kept or deleted
+
+    for (uint64 k = 0; k < segs.size(); k++) {
+        const Node& node(nodes[segs[k]]);
+        if (!node.inserted) {
+            if (node.start > orig_next) {
+                indels.push_back(Indel(pos, node.start - orig_next, 0, false));
+            }
+            orig_next = node.start + node.len;
+        } else if (pos > begin) {
+            indels.push_back(Indel(pos - 1, node.len, node.start, true));
+        } else {
+            /*
+             Insertions go after a site, so when there are no sites before this
+             one, we insert after the last original site removed before it,
+             then remove that site.
+             (There's always at least one because insertions never go before
+             the region's first site.)
+             */
+            uint64 n_del = next_orig[k] - orig_next;
+            if (n_del > 1) indels.push_back(Indel(pos, n_del - 1, 0, false));
+            indels.push_back(Indel(pos, node.len, node.start, true));
+            indels.push_back(Indel(pos, 1, 0, false));
+            orig_next += n_del;
+        }
+        pos += node.len;
+    }
+    if (n_orig > orig_next) indels.push_back(Indel(pos, n_orig - orig_next, 0, false));
+
     return;
+}
+
+
+
+
+
+/*
+ Add one tau-leaping period's indels.
+ `events` has the position (relative to `begin`, on the region at the start of
+ the period) and indel type for each indel, sorted by position.
+ Positions are converted to where each indel goes after the ones before it
+ have been added, then all of them are added to `hap_chrom` and `rate_inds`
+ in one pass.
+ Indels that would start inside a previous deletion start right after it instead.
+ */
+inline int IndelMutator::batch_indels__(
+        const std::vector<std::pair<uint64, uint32>>& events,
+        std::vector<Indel>& indels,
+        std::string& seqs,
+        const uint64& begin,
+        uint64& end,
+        SiteRates& rate_inds,
+        SubMutator& subs,
+        HapChrom& hap_chrom,
+        pcg64& eng,
+        Progress& prog_bar) {
+
+    indels.clear();
+    seqs.clear();
+    if (events.empty()) return 0;
+    indels.reserve(events.size());
+
+    uint32 iters = 0;
+    // Position on the current region minus position at the start of the period:
+    sint64 shift = 0;
+    // Positions (at the start of the period) before this one have been deleted:
+    uint64 min_pos = 0;
+
+    for (const std::pair<uint64, uint32>& ev : events) {
+
+        // The amount that this indel-type changes the chromosome size:
+        const double& change(changes(ev.second));
+
+#ifdef __JACKALOPE_DEBUG
+        if (change == 0) stop("change == 0 inside add_indels");
+#endif
+
+        // Check for user interrupt every 1000 indels:
+        if (interrupt_check(iters, prog_bar)) return -1;
+
+        uint64 pos0 = std::max(ev.first, min_pos);
+        uint64 pos = begin + static_cast<uint64>(static_cast<sint64>(pos0) + shift);
+
+        if (change > 0) {
+            uint64 size = static_cast<uint64>(change);
+            if (pos >= end) pos = end - 1;
+            indels.push_back(Indel(pos, size, seqs.size(), true));
+            for (uint32 j = 0; j < size; j++) seqs += insert.sample(eng);
+            shift += static_cast<sint64>(size);
+            end += size;
+        } else {
+            if (pos >= end) continue;
+            uint64 size = std::min(static_cast<uint64>(std::abs(change)), end - pos);
+            indels.push_back(Indel(pos, size, 0, false));
+            shift -= static_cast<sint64>(size);
+            min_pos = pos0 + size;
+            end -= size;
+            if (end == begin) break;
+        }
+
+    }
+
+    hap_chrom.add_indels(indels, seqs);
+    subs.indels_adjust(indels, begin, rate_inds, eng);
+
+    return 0;
 
 }
 
 
 
+/*
+ Add indels from `segs` to the chromosome and start `segs` over on the new region.
+ */
+inline void IndelMutator::commit_segments__(IndelSegments& segs,
+                                            std::vector<Indel>& indels,
+                                            std::string& seqs,
+                                            const uint64& begin,
+                                            uint64& end,
+                                            SiteRates& rate_inds,
+                                            SubMutator& subs,
+                                            HapChrom& hap_chrom,
+                                            pcg64& eng) {
+
+    segs.to_indels(begin, indels);
+    hap_chrom.add_indels(indels, seqs);
+    subs.indels_adjust(indels, begin, rate_inds, eng);
+
+    end = begin + segs.size();
+    segs.reset(end - begin);
+    seqs.clear();
+
+    return;
+}
+
+
+/*
+ Exact Doob--Gillespie simulation.
+ Only the region's size affects when the next indel happens and what
+ its position is, so indels are simulated on an `IndelSegments` object and added
+ to the chromosome together in sorted batches.
+ Waiting times and positions use uniform draws that are made in blocks.
+ `status` is set to -1 if the user interrupts, or to 1 if `segs` fails
+ (see `IndelSegments::failed`).
+ */
 inline void IndelMutator::exact_sim(int& status,
                                     double& b_len,
                                     const uint64& begin,
                                     uint64& end,
-                                    std::deque<uint8>& rate_inds,
+                                    SiteRates& rate_inds,
                                     SubMutator& subs,
                                     HapChrom& hap_chrom,
                                     pcg64& eng,
                                     Progress& prog_bar) {
 
+    IndelSegments segs;
+    segs.reset(end - begin);
+    // Indels to add to the chromosome and their inserted sequences:
+    std::vector<Indel> indels;
+    std::string seqs;
 
-    // For insertions:
-    std::string insert_str;
-    insert_str.reserve(rates.n_elem / 2);
-
+    RngBuffer rng;
     uint32 iters = 0;
 
-    double rate = total_rate * (end - begin);
-
-    jump_distr.param(std::exponential_distribution<double>::param_type(rate));
-
-    b_len -= jump_distr(eng);
-
-    uint32 i; // index for which indel-event type
+    // Current region size:
+    uint64 n = end - begin;
 
-
-#ifdef __JACKALOPE_DIAGNOSTICS
-    double csize;
-    arma::vec n_muts;
-#endif
+    /*
+     Exponential waiting times.
+     `unif_01` is in the open interval (0,1) (its smallest value is 2^-53; see
+     `bits_to_01` in pcg.h), so the log is always finite.
+     */
+    b_len -= -std::log(rng.unif_01(eng)) / (total_rate * n);
 
     while (b_len > 0) {
 
@@ -98,18 +244,41 @@ inline void IndelMutator::exact_sim(int& status,
             return;
         }
 
-        i = event_sampler.sample(eng);
+        // Index for which indel-event type:
+        uint32 i = event_sampler.sample_bits(rng.next(eng));
+        const double& change(changes(i));
+
+        if (change > 0) {
+            uint64 size = static_cast<uint64>(change);
+            uint64 pos = static_cast<uint64>(rng.unif_01(eng) * n);
+            segs.insert(pos, seqs.size(), size);
+            for (uint32 j = 0; j < size; j++) seqs += insert.sample(eng);
+            n += size;
+        } else {
+            uint64 size = std::min(static_cast<uint64>(std::abs(change)), n);
+            uint64 pos = static_cast<uint64>(rng.unif_01(eng) * (n - size + 1));
+            segs.erase(pos, size);
+            n -= size;
+        }
 
-        one_indel__(changes(i), insert_str, begin, end, rate_inds, subs, hap_chrom, eng);
+        if (segs.failed()) {
+            status = 1;
+            return;
+        }
 
-        if (end == begin) return;
+        if (n == 0) break;
+
+        if (segs.n_segments() >= jlp::indel_segments_max) {
+            commit_segments__(segs, indels, seqs, begin, end, rate_inds, subs,
+                              hap_chrom, eng);
+        }
 
-        rate = total_rate * (end - begin);
-        jump_distr.param(std::exponential_distribution<double>::param_type(rate));
-        b_len -= jump_distr(eng);
+        b_len -= -std::log(rng.unif_01(eng)) / (total_rate * n);
 
     }
 
+    commit_segments__(segs, indels, seqs, begin, end, rate_inds, subs,
+                      hap_chrom, eng);
 
     return;
 }
@@ -117,22 +286,22 @@ inline void IndelMutator::exact_sim(int& status,
 /*
  This calculates...
  - tau (the period of time over which to generate indels)
- - rates over the whole chromosome and `tau` time units (`rates_tau`)
+ - total rate of all indels over the region being mutated and `tau` time units
+   (`rate_tau`)
  - new branch length after progressing `tau` time units (`b_len`)
+ The region (not the whole chromosome) is used so that evolving a chromosome
+ in segments or gene-tree regions doesn't change the indel rate.
  */
-void IndelMutator::calc_tau(double& b_len, HapChrom& hap_chrom) {
+void IndelMutator::calc_tau(double& b_len, const uint64& region_size) {
 
-    const double chrom_size(hap_chrom.chrom_size);
+    const double size(region_size);
 
-    // Now rates are in units of "indels per unit time" (NOT yet over `tau` time units):
-    rates_tau = rates * chrom_size;
+    // For the expected number of bp changes per time over the region...
+    double mu = mean_change * size;  // mean
+    double sig = var_change * size;  // variance
 
-    // For the expected number of bp changes per time over entire chromosome...
-    double mu = arma::accu(changes % rates_tau);             // mean
-    double sig = arma::accu(changes % changes % rates_tau);  // variance
-
-    tau = std::min(std::max(eps * chrom_size, 1.0) / std::abs(mu),
-                   std::pow(std::max(eps * chrom_size, 1.0), 2U) / sig);
+    tau = std::min(std::max(eps * size, 1.0) / std::abs(mu),
+                   std::pow(std::max(eps * size, 1.0), 2U) / sig);
 
     // We don't want to exceed the remaining branch length
     if (b_len < tau) tau = b_len;
@@ -140,8 +309,8 @@ void IndelMutator::calc_tau(double& b_len, HapChrom& hap_chrom) {
     // Adjust the remaining branch length
     b_len -= tau;
 
-    // Now this vector is in units of "indels per `tau` time units"
-    rates_tau *= tau;
+    // In units of "indels per `tau` time units"
+    rate_tau = total_rate * size * tau;
 
     return;
 
@@ -153,7 +322,7 @@ void IndelMutator::calc_tau(double& b_len, HapChrom& hap_chrom) {
 int IndelMutator::add_indels(double b_len,
                              const uint64& begin,
                              uint64& end,
-                             std::deque<uint8>& rate_inds,
+                             SiteRates& rate_inds,
                              SubMutator& subs,
                              HapChrom& hap_chrom,
                              pcg64& eng,
@@ -184,11 +353,11 @@ int IndelMutator::add_indels(double b_len,
         return status;
     }
 
-    // Vector of indel-type indices, one item per indel "event"
-    std::vector<uint32> events;
-    // For insertions:
-    std::string insert_str;
-    insert_str.reserve(rates.n_elem / 2);
+    // Vector of indel-type indices and positions, one item per indel "event"
+    std::vector<std::pair<uint64, uint32>> events;
+    // Indels to add to the chromosome and their inserted sequences:
+    std::vector<Indel> indels;
+    std::string seqs;
 
     uint32 iters = 0;
 
@@ -201,64 +370,52 @@ int IndelMutator::add_indels(double b_len,
 
         /*
          ----------------
-         Determine how many of each indel-type occur over `tau` time units:
+         Determine how many indels occur over `tau` time units:
          ----------------
          */
 
-        calc_tau(b_len, hap_chrom);
+        calc_tau(b_len, end - begin);
+
+        distr.param(std::poisson_distribution<uint32>::param_type(rate_tau));
+        uint32 n_events = distr(eng);
 
 #ifdef __JACKALOPE_DIAGNOSTICS
         csize = hap_chrom.size();
-        n_muts.zeros(rates_tau.n_elem);
+        n_muts.zeros(rates.n_elem);
 #endif
 
         // Reset `events` between rounds:
         if (events.size() > 0) events.clear();
-        // Reserve memory (`arma::accu(rates_tau)` is the expected value of the # events)
-        events.reserve(1 + 1.5 * arma::accu(rates_tau));
-
-        for (uint32 i = 0; i < rates_tau.n_elem; i++) {
-
-            distr.param(std::poisson_distribution<uint32>::param_type(rates_tau(i)));
-
-            uint32 n_events = distr(eng);
-
-#ifdef __JACKALOPE_DIAGNOSTICS
-            n_muts(i) += n_events;
-#endif
-
-            for (uint32 j = 0; j < n_events; j++) events.push_back(i);
-
-            if (interrupt_check(iters, prog_bar, 10)) return -1;
-
-        }
+        events.reserve(n_events);
 
         /*
          ----------------
-         Adding indels in random order:
+         Sampling indel types (with the same alias sampler as for exact simulations)
+         and positions (on the region at the start of this period), then
+         adding indels from front to back:
          ----------------
          */
-        jlp_shuffle<std::vector<uint32>>(events, eng);   // shuffle them first
-
-        iters = 0;
-
-        for (uint32 i = 0; i < events.size(); i++) {
-
-            // The amount that this indel-type changes the chromosome size:
-            double& change(changes(events[i]));
-
-#ifdef __JACKALOPE_DEBUG
-            if (change == 0) stop("change == 0 inside add_indels");
+        const uint64 region_size = end - begin;
+        for (uint32 j = 0; j < n_events; j++) {
+            uint32 i = event_sampler.sample(eng);
+            const double& change(changes(i));
+            uint64 n = region_size;
+            if (change < 0) {
+                n -= std::min(static_cast<uint64>(std::abs(change)), region_size);
+                n++;
+            }
+            events.emplace_back(static_cast<uint64>(runif_01(eng) * n), i);
+#ifdef __JACKALOPE_DIAGNOSTICS
+            n_muts(i)++;
 #endif
-
-            // Check for user interrupt every 1000 indels:
             if (interrupt_check(iters, prog_bar)) return -1;
-
-            one_indel__(change, insert_str, begin, end, rate_inds, subs, hap_chrom, eng);
-
-            if (end == begin) return 0;
-
         }
+        std::sort(events.begin(), events.end());
+
+        int status = batch_indels__(events, indels, seqs, begin, end,
+                                    rate_inds, subs, hap_chrom, eng, prog_bar);
+        if (status != 0) return status;
+        if (end == begin) return 0;
 
 #ifdef __JACKALOPE_DIAGNOSTICS
         Rcout << "+- " << csize << ' ' << tau << " | ";
@@ -15,14 +15,16 @@
 #include <vector>  // vector class
 #include <string>  // string class
 #include <random>  // poisson_distribution
+#include <utility>  // pair
+#include <limits>  // numeric_limits
 
 
 #include "jackalope_types.h" // integer types
 #include "hap_classes.h"  // Hap* classes
-#include "pcg.h"  // pcg seeding
+#include "pcg.h"  // pcg seeding, mix64
 #include "alias_sampler.h"  // alias method of sampling
 #include "util.h"  // str_stop
-#include "mutator_subs.h"  // SubMutator
+#include "mutator_subs.h"  // SubMutator, SiteRates
 
 
 
@@ -30,6 +32,191 @@ using namespace Rcpp;
 
 
 
+namespace jlp {
+    /*
+     Maximum # segments stored in an `IndelSegments` object before its indels are
+     added to the chromosome during exact indel simulations
+     */
+    const uint64 indel_segments_max = 1048576;
+}
+
+
+/*
+ A chromosome region, stored as an ordered list of segments that are either
+ ranges of the region's original sites or inserted sequences.
+ This lets exact indel simulations find the site at any position and add or remove
+ a range of sites in O(log n) time (where n is the number of segments), without
+ changing the chromosome.
+ Once enough indels have been added, `to_indels` converts them to a sorted batch
+ of indels for `HapChrom::add_indels`.
+
+ Segments are nodes in a treap ordered by position, where each node stores the
+ total number of sites in its subtree.
+ (A Fenwick tree can't be used because insertions add new segments in the middle.)
+ Nodes are stored in one vector and referred to by index, with 0 meaning none.
+ */
+class IndelSegments {
+
+public:
+
+    IndelSegments()
+        : nodes(1), root(0), n_orig(0), prio_state(0), too_many(false) {}
+
+    // Start over with `n_sites` original sites
+    void reset(const uint64& n_sites) {
+        nodes.resize(1);
+        root = 0;
+        n_orig = n_sites;
+        too_many = false;
+        if (n_sites > 0) root = new_node__(0, n_sites, false);
+        return;
+    }
+
+    // Total # sites
+    inline uint64 size() const noexcept {
+        return nodes[root].sum;
+    }
+    // # segments (including ones that have been removed)
+    inline uint64 n_segments() const noexcept {
+        return nodes.size() - 1;
+    }
+    /*
+     Whether there were too many segments to index.
+     This is checked by the caller rather than stopping here, because this object
+     is used inside OpenMP threads. Once it's true, `insert` and `erase`
+     do nothing.
+     */
+    inline bool failed() const noexcept {
+        return too_many;
+    }
+
+    // Add `size` inserted sites (starting at `seq_start` in a string of inserted
+    // sequences) after position `pos`
+    void insert(const uint64& pos, const uint64& seq_start, const uint64& size) {
+        if (too_many) return;
+        uint32 a, b;
+        split__(root, pos + 1, a, b);
+        uint32 n = new_node__(seq_start, size, true);
+        root = merge__(merge__(a, n), b);
+        return;
+    }
+
+    // Remove `size` sites starting at position `pos`
+    void erase(const uint64& pos, const uint64& size) {
+        if (too_many) return;
+        uint32 a, b, c, d;
+        split__(root, pos, a, b);
+        split__(b, size, c, d);
+        root = merge__(a, d);
+        return;
+    }
+
+    /*
+     Convert to indels (starting at chromosome position `begin`) that, when added
+     in order, change the original sites to the current ones.
+     */
+    void to_indels(const uint64& begin, std::vector<Indel>& indels) const;
+
+private:
+
+    struct Node {
+        uint64 start;  // first original site, or start of inserted sequence
+        uint64 len;    // # sites in this segment
+        uint64 sum;    // # sites in this segment and its subtree
+        uint64 prio;
+        uint32 left;
+        uint32 right;
+        bool inserted;
+        Node() : start(0), len(0), sum(0), prio(0), left(0), right(0), inserted(false) {}
+    };
+
+    std::vector<Node> nodes;
+    uint32 root;
+    uint64 n_orig;  // # original sites
+    uint64 prio_state;  // for making node priorities
+    bool too_many;  // whether `nodes` ran out of indices (see `failed`)
+
+    // (Returns the empty node `0` if there are too many nodes)
+    uint32 new_node__(const uint64& start, const uint64& len, const bool& inserted) {
+        if (nodes.size() >= std::numeric_limits<uint32>::max()) {
+            too_many = true;
+            return 0;
+        }
+        Node node;
+        node.start = start;
+        node.len = len;
+        node.sum = len;
+        prio_state += 0x9E3779B97F4A7C15ULL;
+        node.prio = mix64(prio_state);
+        node.inserted = inserted;
+        nodes.push_back(node);
+        return nodes.size() - 1;
+    }
+
+    inline void update__(const uint32& t) {
+        Node& node(nodes[t]);
+        node.sum = node.len + nodes[node.left].sum + nodes[node.right].sum;
+        return;
+    }
+
+    /*
+     Split `t` so that `l` has the first `k` sites, and `r` has the rest.
+     (Arguments here and in `merge__` are passed by value because they're often
+     fields of `nodes`, and adding a node can move them.)
+     */
+    void split__(const uint32 t, const uint64 k, uint32& l, uint32& r) {
+        if (t == 0) {
+            l = r = 0;
+            return;
+        }
+        const uint64 ls = nodes[nodes[t].left].sum;
+        uint32 x, y;
+        if (k <= ls) {
+            split__(nodes[t].left, k, x, y);
+            nodes[t].left = y;
+            update__(t);
+            l = x;
+            r = t;
+        } else if (k >= (ls + nodes[t].len)) {
+            split__(nodes[t].right, k - ls - nodes[t].len, x, y);
+            nodes[t].right = x;
+            update__(t);
+            l = t;
+            r = y;
+        } else {
+            // Split this segment in two:
+            const uint64 kk = k - ls;
+            uint32 n2 = new_node__(nodes[t].start + kk, nodes[t].len - kk,
+                                   nodes[t].inserted);
+            nodes[t].len = kk;
+            y = nodes[t].right;
+            nodes[t].right = 0;
+            update__(t);
+            l = t;
+            r = merge__(n2, y);
+        }
+        return;
+    }
+
+    uint32 merge__(const uint32 l, const uint32 r) {
+        if (l == 0) return r;
+        if (r == 0) return l;
+        if (nodes[l].prio > nodes[r].prio) {
+            uint32 x = merge__(nodes[l].right, r);
+            nodes[l].right = x;
+            update__(l);
+            return l;
+        }
+        uint32 x = merge__(l, nodes[r].left);
+        nodes[r].left = x;
+        update__(r);
+        return r;
+    }
+
+};
+
+
+
 
 
 
@@ -48,12 +235,16 @@ public:
     double eps;
     // For creating insertion sequences:
     AliasStringSampler<std::string> insert;
-    // For total rate of all events if doing exact simulations
+    // Total rate of all events, per bp per unit time
     double total_rate;
-    // For sampling which event occurred if doing exact simulations
+    // For sampling which event occurred (with probabilities proportional to `rates`)
     AliasSampler event_sampler;
+    // Mean and variance of the change in chromosome size, per bp per unit time
+    double mean_change;
+    double var_change;
 
-    IndelMutator() {}
+    IndelMutator()
+        : eps(0), total_rate(0), mean_change(0), var_change(0), tau(0), rate_tau(0) {}
     IndelMutator(const arma::vec& insertion_rates,
                  const arma::vec& deletion_rates,
                  const double& epsilon,
@@ -64,9 +255,10 @@ public:
           insert("TCAG", pi_tcag),
           total_rate(0),
           event_sampler(),
+          mean_change(0),
+          var_change(0),
           tau(0),
-          rates_tau(insertion_rates.n_elem + deletion_rates.n_elem),
-          n_events(insertion_rates.n_elem + deletion_rates.n_elem) {
+          rate_tau(0) {
 
         uint32 n = insertion_rates.n_elem;
         uint32 m = deletion_rates.n_elem;
@@ -84,13 +276,17 @@ public:
 
         event_sampler = AliasSampler(rates.t());
 
+        mean_change = arma::accu(changes % rates);
+        var_change = arma::accu(changes % changes % rates);
+
     }
 
     IndelMutator(const IndelMutator& other)
         : rates(other.rates), changes(other.changes), eps(other.eps),
           insert(other.insert), total_rate(other.total_rate),
-          event_sampler(other.event_sampler), tau(other.tau),
-          rates_tau(other.rates_tau), n_events(other.n_events) {}
+          event_sampler(other.event_sampler), mean_change(other.mean_change),
+          var_change(other.var_change), tau(other.tau),
+          rate_tau(other.rate_tau) {}
 
     IndelMutator& operator=(const IndelMutator& other) {
         rates = other.rates;
@@ -99,9 +295,10 @@ public:
         insert = other.insert;
         total_rate = other.total_rate;
         event_sampler = other.event_sampler;
+        mean_change = other.mean_change;
+        var_change = other.var_change;
         tau = other.tau;
-        rates_tau = other.rates_tau;
-        n_events = other.n_events;
+        rate_tau = other.rate_tau;
         return *this;
     }
 
@@ -110,7 +307,7 @@ public:
     int add_indels(double b_len,
                    const uint64& begin,
                    uint64& end,
-                   std::deque<uint8>& rate_inds,
+                   SiteRates& rate_inds,
                    SubMutator& subs,
                    HapChrom& hap_chrom,
                    pcg64& eng,
@@ -120,38 +317,45 @@ public:
 private:
 
 
-    void calc_tau(double& b_len, HapChrom& hap_chrom);
+    void calc_tau(double& b_len, const uint64& region_size);
 
     // For generating # events per time period:
     std::poisson_distribution<uint32> distr = std::poisson_distribution<uint32>(1);
     // For "tau-leaping", `tau` is the time by which branch length can be split:
     double tau;
-    // For storing rate over the entire chromosome over `tau` time units
-    arma::vec rates_tau;
-    // For storing # events that occur over `tau` time units, for each indel type + size
-    std::vector<uint32> n_events;
-    // For generating jump lengths if doing exact simulations
-    std::exponential_distribution<double> jump_distr =
-        std::exponential_distribution<double>(1);
-
-
-    // Add just one indel
-    inline void one_indel__(const double& change,
-                            std::string& insert_str,
-                            const uint64& begin,
-                            uint64& end,
-                            std::deque<uint8>& rate_inds,
-                            SubMutator& subs,
-                            HapChrom& hap_chrom,
-                            pcg64& eng);
-
+    // For storing total rate over the region being mutated over `tau` time units
+    double rate_tau;
+
+    // Add indels from an `IndelSegments` object during exact simulations
+    inline void commit_segments__(IndelSegments& segs,
+                                  std::vector<Indel>& indels,
+                                  std::string& seqs,
+                                  const uint64& begin,
+                                  uint64& end,
+                                  SiteRates& rate_inds,
+                                  SubMutator& subs,
+                                  HapChrom& hap_chrom,
+                                  pcg64& eng);
+
+
+    // Add a batch of indels during tau-leaping
+    inline int batch_indels__(const std::vector<std::pair<uint64, uint32>>& events,
+                              std::vector<Indel>& indels,
+                              std::string& seqs,
+                              const uint64& begin,
+                              uint64& end,
+                              SiteRates& rate_inds,
+                              SubMutator& subs,
+                              HapChrom& hap_chrom,
+                              pcg64& eng,
+                              Progress& prog_bar);
 
     // Exact, rather than approximation to Doob--Gillespie algorithm
     inline void exact_sim(int& status,
                           double& b_len,
                           const uint64& begin,
                           uint64& end,
-                          std::deque<uint8>& rate_inds,
+                          SiteRates& rate_inds,
                           SubMutator& subs,
                           HapChrom& hap_chrom,
                           pcg64& eng,
@@ -7,92 +7,64 @@
 #include <progress.hpp>  // for the progress bar
 #include <vector>  // vector class
 #include <string>  // string class
+#include <cmath>  // log, log1p, floor
+#include <algorithm>  // max, min
+#include <memory>  // shared_ptr, make_shared
+#include <array>  // array class
 
 
-#include "mutator_subs.h" // SubMutator
+#include "mutator_subs.h" // SubMutator, SubMats, SubMatsCache
 #include "hap_classes.h"  // Hap* classes
-#include "pcg.h"  // runif_01
+#include "pcg.h"  // RngBuffer
 #include "util.h"  // interrupt_check
 #include "alias_sampler.h"  // alias method of sampling
+#include "nt_matrix.h"  // NtMatrix, NtVector
 
 
 using namespace Rcpp;
 
 
 
+namespace jlp {
+    /*
+     Smallest substitution probability at which `add_subs` uses a dense copy of
+     a region.
+     It's `jlp::dense_subs_density` unless changed for testing
+     (see `set_dense_subs_density` below).
+     All threads read it without locking, so it must not be changed while
+     chromosomes are being evolved.
+     */
+    static double dense_subs_cutoff = dense_subs_density;
+}
+
+
+
 
 int SubMutator::new_rates(const uint64& begin,
                           const uint64& end,
-                          std::deque<uint8>& rate_inds,
+                          SiteRates& rate_inds,
                           pcg64& eng,
                           Progress& prog_bar) {
 
     if (!site_var) {
-        if (!rate_inds.empty()) {
-            rate_inds.clear();
-        }
+        rate_inds.clear();
         return 0;
     }
 
+    if (prog_bar.is_aborted() || prog_bar.check_abort()) return -1;
+
     // (Gammas go from 0 to (n-1), invariants are n.)
     const uint8 n = Q.size();
 
-    const uint64 N = end - begin;
-    const uint64 N0 = rate_inds.size();
-
-    uint32 iters = 0;
+    // Categories are made from a hash of each site's ID and this seed:
+    rate_inds.reset(end - begin, eng(), n, invariant);
 
 #ifdef __JACKALOPE_DIAGNOSTICS
     Rcout << std::endl << "~~ rates for " << begin << ' ' << end << " = ";
-#endif
-
-    if (N0 > N) {
-        rate_inds.resize(N);
-        clear_memory<std::deque<uint8>>(rate_inds);
-    }
-
-    if (invariant <= 0) {
-
-        for (uint64 i = 0; i < rate_inds.size(); i++) {
-            rate_inds[i] = static_cast<uint8>(runif_01(eng) * n);
-            if (interrupt_check(iters, prog_bar)) return -1;
-#ifdef __JACKALOPE_DIAGNOSTICS
-            // This will be invisible without being converted to unsigned
-            Rcout << static_cast<unsigned>(rate_inds[i]) << ' ';
-#endif
-        }
-        while (rate_inds.size() < N) {
-            rate_inds.push_back(static_cast<uint8>(runif_01(eng) * n));
-            if (interrupt_check(iters, prog_bar)) return -1;
-#ifdef __JACKALOPE_DIAGNOSTICS
-            Rcout << static_cast<unsigned>(rate_inds.back()) << ' ';
-#endif
-        }
-
-    } else {
-
-        for (uint64 i = 0; i < rate_inds.size(); i++) {
-            if (runif_01(eng) > invariant) {
-                rate_inds[i] = static_cast<uint8>(runif_01(eng) * n);
-            } else rate_inds[i] = n;
-            if (interrupt_check(iters, prog_bar)) return -1;
-#ifdef __JACKALOPE_DIAGNOSTICS
-            Rcout << static_cast<unsigned>(rate_inds[i]) << ' ';
-#endif
-        }
-        while (rate_inds.size() < N) {
-            if (runif_01(eng) > invariant) {
-                rate_inds.push_back(static_cast<uint8>(runif_01(eng) * n));
-            } else rate_inds.push_back(n);
-            if (interrupt_check(iters, prog_bar)) return -1;
-#ifdef __JACKALOPE_DIAGNOSTICS
-            Rcout << static_cast<unsigned>(rate_inds.back()) << ' ';
-#endif
-        }
-
+    for (uint64 i = 0; i < rate_inds.size(); i++) {
+        // This will be invisible without being converted to unsigned
+        Rcout << static_cast<unsigned>(rate_inds[i]) << ' ';
     }
-
-#ifdef __JACKALOPE_DIAGNOSTICS
     Rcout << std::endl;
 #endif
 
@@ -103,284 +75,133 @@ int SubMutator::new_rates(const uint64& begin,
 
 
 
-inline void SubMutator::adjust_mats(const double& b_len) {
+/*
+ Make P(t) matrices for branch length `b_len`, then the substitution probabilities
+ and alias samplers from them.
+ This is only called by `mats_cache` when it doesn't already have these.
+ */
+SubMatsCache::MatsPtr SubMutator::make_mats(const double& b_len) const {
 
-    // UNREST model
-    if (U.size() == 0) {
-        for (uint32 i = 0; i < Q.size(); i++) {
-            // Adjust P(t) matrix using repeated matrix squaring
-            Pt_calc(Q[i], 30, b_len, Pt[i]);
-            // Now adjust the alias samplers:
-            std::vector<AliasSampler>& samp(samplers[i]);
 #ifdef __JACKALOPE_DEBUG
-            if (samp.size() != 4) stop("SubMutator::adjust_mats-> samp.size() != 4");
-#endif
-            for (uint32 j = 0; j < 4; j++) {
-                samp[j] = AliasSampler(Pt[i].row(j));
-            }
-        }
-    } else {
-#ifdef __JACKALOPE_DEBUG
-        if (U.size() != Q.size()) stop("SubMutator::adjust_mats-> U.size() != Q.size()");
+    if (U.size() > 0) {
+        if (U.size() != Q.size()) stop("SubMutator::make_mats-> U.size() != Q.size()");
         if (Ui.size() != Q.size()) {
-            stop("SubMutator::adjust_mats-> Ui.size() != Q.size()");
-        }
-        if (L.size() != Q.size()) stop("SubMutator::adjust_mats-> L.size() != Q.size()");
-#endif
-        // All other models
-        for (uint32 i = 0; i < Q.size(); i++) {
-            // Adjust P(t) matrix using eigenvalues and eigenvectors in U, Ui, and L
-            Pt_calc(U[i], Ui[i], L[i], b_len, Pt[i]);
-            // Now adjust the alias samplers:
-            std::vector<AliasSampler>& samp(samplers[i]);
-#ifdef __JACKALOPE_DEBUG
-            if (samp.size() != 4) stop("SubMutator::adjust_mats-> samp.size() != 4");
-#endif
-            for (uint32 j = 0; j < 4; j++) {
-                samp[j] = AliasSampler(Pt[i].row(j));
-            }
+            stop("SubMutator::make_mats-> Ui.size() != Q.size()");
         }
+        if (L.size() != Q.size()) stop("SubMutator::make_mats-> L.size() != Q.size()");
     }
-
-    return;
-
-}
-
-
-
-
-//' Most of the work for `subs_before_muts`
-//'
-//' @noRd
-//'
-inline void SubMutator::subs_before_muts__(const uint64& pos,
-                                           uint64& mut_i,
-                                           const std::string& bases,
-                                           const uint8& rate_i,
-                                           HapChrom& hap_chrom,
-                                           pcg64& eng) {
-
-    const uint8& c_i(char_map[hap_chrom.ref_chrom->nucleos[pos]]);
-    if (c_i > 3) return; // only changing T, C, A, or G
-    AliasSampler& samp(samplers[rate_i][c_i]);
-    uint8 nt_i = samp.sample(eng);
-    if (nt_i != c_i) {
-#ifdef __JACKALOPE_DIAGNOSTICS
-        // __ <new pos> <rate index> <old nucleotide>-<new nucleotide>
-        Rcout << "__ " << pos << ' ' << static_cast<unsigned>(rate_i) << ' ' <<
-            bases[c_i] << '-' << bases[nt_i] << std::endl;
 #endif
-        hap_chrom.mutations.push_front(pos, pos, bases[nt_i]);
-        mut_i++;
-    }
-
-    return;
 
-}
+    std::shared_ptr<SubMats> mats = std::make_shared<SubMats>(Q.size());
+    NtMatrix Pt;
+    NtVector probs;
 
-//' Add substitutions within a range (pos to (end-1)) before any mutations have occurred.
-//'
-//' @noRd
-//'
-inline int SubMutator::subs_before_muts(const uint64& begin,
-                                        const uint64& end,
-                                        uint64& mut_i,
-                                        const uint8& max_gamma,
-                                        const std::string& bases,
-                                        const std::deque<uint8>& rate_inds,
-                                        HapChrom& hap_chrom,
-                                        pcg64& eng,
-                                        Progress& prog_bar,
-                                        uint32& iters) {
-
-#ifdef __JACKALOPE_DEBUG
-    if (rate_inds.empty() && max_gamma > 1) {
-        stop("rate_inds shouldn't be empty when max_gamma > 1");
-    }
-    if (rate_inds.empty() && invariant > 0) {
-        stop("rate_inds shouldn't be empty when invariant > 0");
-    }
-#endif
-
-    uint64 size = end - begin;
-    uint64 pos;
-
-    if (site_var) {
-
-        // Going backwards from `end-1` to `begin` so we can add to front of `mutations`
-        for (uint64 i = 1; i <= size; i++) {
-
-            pos = end - i;
-
-            const uint8& rate_i(rate_inds[(pos-begin)]);
-            if (rate_i > max_gamma) continue; // this is an invariant region
-
-            subs_before_muts__(pos, mut_i, bases, rate_i, hap_chrom, eng);
-
-            if (interrupt_check(iters, prog_bar)) return -1;
+    for (uint32 i = 0; i < Q.size(); i++) {
 
+        if (U.size() == 0) {
+            // UNREST model: adjust P(t) matrix using repeated matrix squaring
+            Pt_calc(Q[i], 30, b_len, Pt);
+        } else {
+            // All other models: use eigenvalues and eigenvectors in U, Ui, and L
+            Pt_calc(U[i], Ui[i], L[i], b_len, Pt);
         }
 
-
-    } else {
-
-        const uint8 rate_i = 0;
-
-        for (uint64 i = 1; i <= size; i++) {
-
-            pos = end - i;
-
-            subs_before_muts__(pos, mut_i, bases, rate_i, hap_chrom, eng);
-
-            if (interrupt_check(iters, prog_bar)) return -1;
-
+        /*
+         Now make the substitution probabilities and the alias samplers.
+         The samplers only choose among the three nucleotides that differ from the
+         current one, so they're conditional on a substitution occurring.
+         */
+        std::array<FixedAliasSampler<4>, 4>& samp(mats->samplers[i]);
+        NtVector& sp(mats->sub_probs[i]);
+        for (uint32 j = 0; j < 4; j++) {
+            double off_diag = 0;
+            for (uint32 k = 0; k < 4; k++) {
+                // (Rounding error can make tiny probabilities negative)
+                probs[k] = std::max(Pt(j, k), 0.0);
+                if (k != j) off_diag += probs[k];
+            }
+            sp[j] = off_diag / (off_diag + probs[j]);
+            if (sp[j] > 0) {
+                probs[j] = 0;
+                samp[j] = FixedAliasSampler<4>(probs);
+            }
+            if (sp[j] > mats->max_sub_prob) mats->max_sub_prob = sp[j];
         }
-
     }
 
-
-    return 0;
+    return mats;
 
 }
 
-//' Add substitutions within a range (pos to (end-1)) after mutations have occurred.
-//'
-//' @noRd
-//'
-inline void SubMutator::subs_after_muts__(const uint64& pos,
-                                          uint64& mut_i,
-                                          const std::string& bases,
-                                          const uint8& rate_i,
-                                          HapChrom& hap_chrom,
-                                          pcg64& eng) {
-
-
-    AllMutations& mutations(hap_chrom.mutations);
-    const std::string& reference(hap_chrom.ref_chrom->nucleos);
-
-    const uint8& c_i(char_map[hap_chrom.get_char_(pos, mut_i)]);
-    if (c_i > 3) return; // only changing T, C, A, or G
-
-    AliasSampler& samp(samplers[rate_i][c_i]);
-    uint8 nt_i = samp.sample(eng);
-    const char& nucleo(bases[nt_i]);
 
-    if (nt_i != c_i) {
 
-        sint64 ind = pos - mutations.new_pos[mut_i]; // <-- should always be >= 0
 
-        // If `pos` is within the mutation chromosome:
-        if (ind <= hap_chrom.size_modifier(mut_i)) {
-
-#ifdef __JACKALOPE_DIAGNOSTICS
-            // __ <new pos> <rate index> <old nucleotide>-<new nucleotide>
-            Rcout << "__ " << pos << ' ' << static_cast<unsigned>(rate_i) << ' ' <<
-                bases[c_i] << '-' << nucleo << std::endl;
-#endif
-
-            /*
-             If this new mutation reverts a substitution back to reference state,
-             delete the mutation from `mutations`.
-             Otherwise, adjust the mutation's sequence.
-             When `mut_i == 0`, doing this would make `mut_i` become negative,
-             so I just keep the mutation if `mut_i == 0`.
-             */
-            if ((hap_chrom.size_modifier(mut_i) == 0) &&
-                (reference[mutations.old_pos[mut_i]] == nucleo) &&
-                mut_i > 0) {
-                mutations.erase(mut_i);
-                mut_i--;
-            } else mutations.nucleos[mut_i][ind] = nucleo;
-
-        } else {
-            // If `pos` is in the reference chromosome following the mutation:
-            uint64 old_pos_ = ind + (mutations.old_pos[mut_i] -
-                hap_chrom.size_modifier(mut_i));
-#ifdef __JACKALOPE_DIAGNOSTICS
-            // __ <new pos> <rate index> <old nucleotide>-<new nucleotide>
-            Rcout << "__ " << pos << ' ' << static_cast<unsigned>(rate_i) << ' ' <<
-                bases[c_i] << '-' << nucleo << std::endl;
-#endif
-            mutations.insert(mut_i + 1, old_pos_, pos, nucleo);
-            mut_i++;
-        }
-
-    }
-
-    return;
-
-}
-
-//' Add substitutions within a range (pos to (end-1)) after mutations have occurred.
+//' Add a substitution to a single site.
+//'
+//' `n_before` is the number of mutations at or before `pos`, and it's updated
+//' if a mutation is added or removed.
 //'
 //' @noRd
 //'
-inline int SubMutator::subs_after_muts(uint64& pos,
-                                       const uint64& begin,
-                                       const uint64& end1,
-                                       const uint64& end2,
-                                       uint64& mut_i,
-                                       const uint8& max_gamma,
-                                       const std::string& bases,
-                                       const std::deque<uint8>& rate_inds,
-                                       HapChrom& hap_chrom,
-                                       pcg64& eng,
-                                       Progress& prog_bar,
-                                       uint32& iters) {
-
-    uint64 end = std::min(end1, end2);
-
-    if (site_var) {
-
-        while (pos < end) {
-
-            const uint8& rate_i(rate_inds[(pos-begin)]);
-            if (rate_i > max_gamma) {
-                pos++;
-                continue; // this is an invariant region
-            }
+inline void SubMutator::sub_one_site_(const uint64& pos,
+                                      uint64& n_before,
+                                      const char& nucleo,
+                                      HapChrom& hap_chrom) {
 
-            subs_after_muts__(pos, mut_i, bases, rate_i, hap_chrom, eng);
-            ++pos;
-            if (interrupt_check(iters, prog_bar)) return -1;
-
-        }
-
-    } else {
+    AllMutations& mutations(hap_chrom.mutations);
 
-        const uint8 rate_i = 0;
+    // If `pos` is before all mutations, old and new positions are the same:
+    if (n_before == 0) {
+        mutations.push_front(pos, pos, nucleo);
+        n_before++;
+        return;
+    }
 
-        while (pos < end) {
+    const uint64 mut_i = n_before - 1;
+    sint64 ind = pos - mutations.new_pos(mut_i); // <-- should always be >= 0
 
-            subs_after_muts__(pos, mut_i, bases, rate_i, hap_chrom, eng);
-            ++pos;
-            if (interrupt_check(iters, prog_bar)) return -1;
+    // If `pos` is within the mutation chromosome:
+    if (ind <= hap_chrom.size_modifier(mut_i)) {
 
-        }
+        /*
+         If this new mutation reverts a substitution back to reference state,
+         delete the mutation from `mutations`.
+         Otherwise, adjust the mutation's sequence.
+         */
+        if ((hap_chrom.size_modifier(mut_i) == 0) &&
+            (hap_chrom.ref_chrom->nucleos[mutations.old_pos(mut_i)] == nucleo)) {
+            mutations.erase(mut_i);
+            n_before--;
+        } else mutations.set_nucleo(mut_i, ind, nucleo);
 
+    } else {
+        // If `pos` is in the reference chromosome following the mutation:
+        uint64 old_pos_ = ind + (mutations.old_pos(mut_i) -
+            hap_chrom.size_modifier(mut_i));
+        mutations.insert(n_before, old_pos_, pos, nucleo);
+        n_before++;
     }
 
-
-    return 0;
+    return;
 
 }
 
 
 
 
-
-
-
 //' Add substitutions for a whole chromosome or just part of one.
 //'
 //' Here, `end` is NOT inclusive, so can be == hap_chrom.size()
 //'
+//' This does the checks and gets the matrices for `b_len`, then passes them to
+//' the version of `add_subs_` that was chosen for these rate categories.
+//'
 //' @noRd
 //'
 int SubMutator::add_subs(const double& b_len,
                          const uint64& begin,
                          const uint64& end,
-                         const std::deque<uint8>& rate_inds,
+                         const SiteRates& rate_inds,
                          HapChrom& hap_chrom,
                          pcg64& eng,
                          Progress& prog_bar) {
@@ -400,92 +221,193 @@ int SubMutator::add_subs(const double& b_len,
         Rcout << std::endl << end << ' ' << hap_chrom.size() << std::endl;
         stop("end > hap_chrom.size() in add_subs");
     }
+    if (site_var && rate_inds.size() != (end - begin)) {
+        stop("rate_inds should match the region size with among-site variability");
+    }
+    if (!mats_cache) stop("mats_cache is empty in add_subs");
 #endif
 
 
     if (prog_bar.is_aborted() || prog_bar.check_abort()) return -1;
 
-    adjust_mats(b_len);
+    // Matrices for this branch length, made here or by another chromosome or thread:
+    const SubMatsCache::MatsPtr mats = mats_cache->get(
+        b_len, [this](const double& t) { return make_mats(t); });
+
+    if (mats->max_sub_prob <= 0) return 0;
+
+    /*
+     Use a dense copy of the region if enough sites are candidates for
+     substitutions (see `add_subs_`).
+     */
+    SubsKernel kernel = subs_kernel;
+    if (mats->max_sub_prob >= jlp::dense_subs_cutoff) kernel = dense_kernel;
+
+    int status = (this->*kernel)(*mats, begin, end, rate_inds, hap_chrom,
+                  eng, prog_bar);
+
+    return status;
+
+}
+
+
+
+
+//' Inner loop for `add_subs`.
+//'
+//' Rather than sampling every site, this jumps between candidate sites using
+//' geometric draws based on the largest substitution probability (`max_sub_prob`)
+//' across all rate categories and nucleotides.
+//' Each candidate is then accepted with probability
+//' `sub_probs[rate][nt] / max_sub_prob`, so the result has the same distribution
+//' as sampling each site from its row of P(t), but the number of draws scales with
+//' the number of substitutions rather than the number of sites.
+//' Invariant sites and non-TCAG characters simply never get accepted.
+//'
+//' Template parameters are whether there's among-site variability (`site_var_`),
+//' whether any sites can be invariant (`invariant_`), and whether to use a
+//' dense copy of the region (`dense_`).
+//' Without among-site variability, every site uses rate category 0, so
+//' `rate_inds` is never read.
+//'
+//' In dense mode, nucleotides are read from and changed in a copy of one window
+//' of the region at a time (`seq`), which is written back to `hap_chrom` using
+//' `HapChrom::set_region` once we're done with it.
+//' This avoids inserting each substitution into a crowded list of mutations.
+//' Because it uses the same random draws, both modes produce the same output.
+//'
+//' @noRd
+//'
+template <bool site_var_, bool invariant_, bool dense_>
+int SubMutator::add_subs_(const SubMats& mats,
+                          const uint64& begin,
+                          const uint64& end,
+                          const SiteRates& rate_inds,
+                          HapChrom& hap_chrom,
+                          pcg64& eng,
+                          Progress& prog_bar) {
+
+    const std::vector<std::array<FixedAliasSampler<4>, 4>>& samplers(mats.samplers);
+    const std::vector<NtVector>& sub_probs(mats.sub_probs);
+    const double& max_sub_prob(mats.max_sub_prob);
 
-    uint8 max_gamma = Q.size() - 1; // any rate_inds above this means an invariant region
+    const uint8 max_gamma = Q.size() - 1; // any rate_inds above this means an invariant region
     std::string bases = "TCAG";
 
     // To make code less clunky:
     AllMutations& mutations(hap_chrom.mutations);
+    const std::string& reference(hap_chrom.ref_chrom->nucleos);
 
-    int status = 0;
-    uint32 iters = 0;
-
+    // Log probability that a site is NOT a candidate, for geometric jumps:
+    const double log_q = std::log1p(-max_sub_prob);
 
-    uint64 mut_i = 0;
-    uint64 pos = begin;
+    uint32 iters = 0;
+    RngBuffer rng;
+    uint64 rate_run = 0;  // index for the run in `rate_inds` for the current site
 
     /*
-     If there are no mutations or if `end-1` is before the first mutation,
-     then we don't need to use the `mutations` field at all.
+     Number of mutations at or before the current position.
+     This is zero if `begin` is before the first mutation.
      */
-    if (mutations.empty() || ((end-1) < mutations.new_pos.front())) {
-
-        status = subs_before_muts(begin, end, mut_i, max_gamma, bases, rate_inds,
-                                  hap_chrom, eng, prog_bar, iters);
-        return status;
-
+    uint64 n_before = 0;
+    if (!dense_) {
+        n_before = hap_chrom.get_mut_(begin);
+        if (n_before == mutations.size()) {
+            n_before = 0;
+        } else n_before++;
     }
 
+    // Dense copy of positions `win_begin` to `win_end - 1` (dense mode only):
+    std::string seq;
+    uint64 win_begin = begin, win_end = begin;
+    bool win_changed = false;
 
-    /*
-     Index to the Mutation object nearest to (without being past) an input position
-     on the haplotype chromosome.
-     */
-    mut_i = hap_chrom.get_mut_(begin);
+    int status = 0;
 
-    /*
-     If `begin` is before the first mutation (resulting in `mut_i == mutations.size()`),
-     we must process any nucleotides before the first mutation.
-     */
-    if (mut_i == mutations.size()) {
+    for (uint64 pos = begin; pos < end; ++pos) {
 
-        mut_i = 0;
-        // This is the end for now, but will be `pos` below:
-        pos = mutations.new_pos[mut_i];
-        status = subs_before_muts(begin, pos, mut_i, max_gamma, bases,
-                                  rate_inds, hap_chrom, eng, prog_bar, iters);
+        // Jump to the next candidate site:
+        double skip = std::floor(std::log(rng.unif_01(eng)) / log_q);
+        if (skip >= static_cast<double>(end - pos)) break;
+        pos += static_cast<uint64>(skip);
 
-        if (status < 0) return status;
+        uint8 rate_i = 0;
+        if (site_var_) {
+            rate_i = rate_inds.get(pos - begin, rate_run);
+            if (invariant_ && rate_i > max_gamma) continue; // this is an invariant region
+        }
 
-    }
+        char c;
+        if (dense_) {
+            if (pos >= win_end) {
+                if (win_changed) hap_chrom.set_region(seq, win_begin);
+                win_begin = pos;
+                win_end = std::min(end, pos + jlp::dense_subs_window);
+                uint64 mut_i;
+                hap_chrom.set_chrom_chunk(seq, win_begin, win_end - win_begin, mut_i);
+                win_changed = false;
+            }
+            c = seq[pos - win_begin];
+        } else {
+            /*
+             Move to the last mutation at or before `pos`.
+             Candidate sites can be far apart in densely mutated regions, so
+             this uses binary search rather than stepping through mutations.
+             */
+            if (n_before < mutations.size() && mutations.new_pos(n_before) <= pos) {
+                n_before = mutations.upper_bound_new(pos);
+            }
+            if (n_before == 0) {
+                c = reference[pos];
+            } else c = hap_chrom.get_char_(pos, n_before - 1);
+        }
+        const uint8& c_i(char_map[c]);
+        if (c_i > 3) continue; // only changing T, C, A, or G
 
+        // Thin candidates down to this site's substitution probability:
+        const double& sp(sub_probs[rate_i][c_i]);
+        if (sp < max_sub_prob && (rng.unif_01(eng) * max_sub_prob) >= sp) continue;
 
-    /*
-     Now, for each subsequent mutation except the last, process all nucleotides
-     at or after its position but before the next one.
-     */
-    uint64 next_mut_i = mut_i + 1;
-    while (pos < end && next_mut_i < mutations.size()) {
+        uint8 nt_i = samplers[rate_i][c_i].sample_bits(rng.next(eng));
+        if (nt_i == c_i) continue;
 
-        status = subs_after_muts(pos, begin, end, mutations.new_pos[next_mut_i], mut_i,
-                                 max_gamma, bases, rate_inds, hap_chrom, eng, prog_bar,
-                                 iters);
+#ifdef __JACKALOPE_DIAGNOSTICS
+        // __ <new pos> <rate index> <old nucleotide>-<new nucleotide>
+        Rcout << "__ " << pos << ' ' << static_cast<unsigned>(rate_i) << ' ' <<
+            bases[c_i] << '-' << bases[nt_i] << std::endl;
+#endif
 
-        if (status < 0) return status;
+        if (dense_) {
+            seq[pos - win_begin] = bases[nt_i];
+            win_changed = true;
+        } else sub_one_site_(pos, n_before, bases[nt_i], hap_chrom);
+
+        if (interrupt_check(iters, prog_bar)) {
+            status = -1;
+            break;
+        }
 
-        ++mut_i;
-        next_mut_i = mut_i + 1;
     }
 
-    // Now taking care of nucleotides after the last Mutation
-    status = subs_after_muts(pos, begin, end, hap_chrom.chrom_size, mut_i,
-                             max_gamma, bases, rate_inds, hap_chrom, eng, prog_bar,
-                             iters);
+    if (dense_ && win_changed) hap_chrom.set_region(seq, win_begin);
 
     return status;
 
 }
 
 
-
-
-
+SubMutator::SubsKernel SubMutator::choose_kernel(const bool& site_var_,
+                                                 const bool& invariant_,
+                                                 const bool& dense_) {
+    if (dense_) {
+        if (!site_var_) return &SubMutator::add_subs_<false, false, true>;
+        if (invariant_) return &SubMutator::add_subs_<true, true, true>;
+        return &SubMutator::add_subs_<true, false, true>;
+    }
+    if (!site_var_) return &SubMutator::add_subs_<false, false, false>;
+    if (invariant_) return &SubMutator::add_subs_<true, true, false>;
+    return &SubMutator::add_subs_<true, false, false>;
+}
 
 
 
@@ -493,15 +415,14 @@ int SubMutator::add_subs(const double& b_len,
 void SubMutator::deletion_adjust(const uint64& size,
                                  uint64 pos,
                                  const uint64& begin,
-                                 std::deque<uint8>& rate_inds) {
+                                 SiteRates& rate_inds) {
 
     if (!site_var) return;
 
     // Because rate_inds is from `begin` to `end` only
     pos -= begin;
 
-    rate_inds.erase(rate_inds.begin() + pos,
-                    rate_inds.begin() + (pos + size));
+    rate_inds.erase(pos, size);
 
     return;
 
@@ -512,41 +433,32 @@ void SubMutator::deletion_adjust(const uint64& size,
 void SubMutator::insertion_adjust(const uint64& size,
                                   uint64 pos,
                                   const uint64& begin,
-                                  std::deque<uint8>& rate_inds,
+                                  SiteRates& rate_inds,
                                   pcg64& eng) {
 
     if (!site_var) return;
 
-    /*
-     Because `deque::insert` will insert items before `pos`, and we want it after
-     the original `pos`:
-     */
+    // Because we want new sites after the original `pos`:
     pos++;
     // Because rate_inds is from `begin` to `end` only
     pos -= begin;
 
-    // (Gammas go from 0 to (n-1), invariants are n.)
-    const uint8 n = Q.size();
-
-    if (invariant <= 0) {
-
-        for (uint64 i = 0; i < size; i++) {
-            rate_inds.insert(rate_inds.begin() + pos,
-                             static_cast<uint8>(runif_01(eng) * n));
-        }
+    // New sites get a random run of IDs, so their categories are new random ones:
+    rate_inds.insert(pos, size, eng());
 
-    } else {
+    return;
+}
 
-        for (uint64 i = 0; i < size; i++) {
-            if (runif_01(eng) > invariant) {
-                rate_inds.insert(rate_inds.begin() + pos,
-                                 static_cast<uint8>(runif_01(eng) * n));
-            } else rate_inds.insert(rate_inds.begin() + pos, n);
-        }
 
-    }
+// Adjust rate_inds for a batch of indels:
+void SubMutator::indels_adjust(const std::vector<Indel>& indels,
+                               const uint64& begin,
+                               SiteRates& rate_inds,
+                               pcg64& eng) {
 
+    if (!site_var) return;
 
+    rate_inds.add_indels(indels, begin, eng);
 
     return;
 }
@@ -554,3 +466,21 @@ void SubMutator::insertion_adjust(const uint64& size,
 
 
 
+//' Change when substitutions are made in a dense copy of a region.
+//'
+//' Internal function for testing.
+//' Use `0` to always use the dense copy, `Inf` to never use it, and a negative
+//' number to go back to the default.
+//' This changes a value shared by all threads, so it must not be called while
+//' haplotypes are being created.
+//'
+//' @return The previous value.
+//'
+//' @noRd
+//'
+//[[Rcpp::export]]
+double set_dense_subs_density(const double& density) {
+    double old = jlp::dense_subs_cutoff;
+    jlp::dense_subs_cutoff = (density < 0) ? jlp::dense_subs_density : density;
+    return old;
+}
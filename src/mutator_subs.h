@@ -14,12 +14,20 @@
 #include <progress.hpp>  // for the progress bar
 #include <vector>  // vector class
 #include <string>  // string class
+#include <algorithm>  // upper_bound, min
+#include <utility>  // move
+#include <array>  // array class
+#include <cmath>  // exp
+#include <memory>  // shared_ptr, make_shared
+#include <mutex>  // mutex, lock_guard, once_flag, call_once
+#include <unordered_map>  // unordered_map
 
 
 #include "jackalope_types.h" // integer types
-#include "hap_classes.h"  // Hap* classes
-#include "pcg.h"  // pcg seeding
+#include "hap_classes.h"  // Hap* classes, Indel
+#include "pcg.h"  // pcg seeding, mix64
 #include "alias_sampler.h"  // alias method of sampling
+#include "nt_matrix.h"  // NtMatrix, NtVector
 #include "util.h"  // str_stop
 
 
@@ -27,6 +35,25 @@
 using namespace Rcpp;
 
 
+namespace jlp {
+    /*
+     Maximum # (branch length, rate category) combinations whose matrices are kept
+     in a `SubMatsCache`
+     */
+    const uint64 sub_mats_cache_cats = 65536;
+    /*
+     Once at least this proportion of sites in a region are candidates for
+     substitutions, substitutions are made in a dense copy of the region rather
+     than added one at a time to its list of mutations
+     (see `SubMutator::add_subs_`).
+     Below this, rebuilding the region's mutations costs more than it saves.
+     */
+    const double dense_subs_density = 0.02;
+    // Maximum size of the dense copy of a region used for substitutions
+    const uint64 dense_subs_window = 1048576;
+}
+
+
 // All return 4 except for TCAG
 inline std::vector<uint8> make_char_map() {
     std::vector<uint8> out(256, 4);
@@ -38,6 +65,313 @@ inline std::vector<uint8> make_char_map() {
 
 
 
+/*
+ Rate categories (Gammas and invariants) for the sites in one chromosome region.
+
+ Categories aren't stored for each site.
+ Instead, each site has a 64-bit ID, and its category is made from a hash of
+ that ID and a seed that's drawn for each tree.
+ Sites are stored as runs of consecutive IDs, so memory usage and the time to
+ copy this object or to adjust it for indels depend on the number of indels
+ rather than the number of sites.
+ Runs are kept in sorted vectors, so `insert` and `erase` take time linear in
+ the number of runs after `pos`.
+ Batches of indels should instead go through `add_indels`, which takes
+ linear time for the whole batch.
+ Sites at the root of a tree have IDs `0` to `N-1`, and each insertion gets
+ a random run of IDs, so new sites' categories are independent of all others
+ (barring an overlap in IDs, which has negligible probability).
+
+ Categories go from 0 to (n-1) for Gammas, and invariants are n.
+ */
+class SiteRates {
+
+public:
+
+    SiteRates()
+        : starts(), ids(), n_sites(0), seed(0), n_gammas(1), inv_thresh(0) {}
+
+    // Start over with `n_sites_` new sites
+    void reset(const uint64& n_sites_,
+               const uint64& seed_,
+               const uint8& n_gammas_,
+               const double& invariant) {
+        starts.clear();
+        ids.clear();
+        if (n_sites_ > 0) {
+            starts.push_back(0);
+            ids.push_back(0);
+        }
+        n_sites = n_sites_;
+        seed = seed_;
+        n_gammas = n_gammas_;
+        inv_thresh = static_cast<uint64>(std::max(invariant, 0.0) * 4294967296.0);
+        return;
+    }
+
+    void clear() {
+        starts.clear();
+        ids.clear();
+        n_sites = 0;
+        return;
+    }
+
+    inline uint64 size() const noexcept {
+        return n_sites;
+    }
+    inline bool empty() const noexcept {
+        return n_sites == 0;
+    }
+
+    // Category for the site at `pos`
+    inline uint8 operator[](const uint64& pos) const {
+        uint64 r = run__(pos);
+        return category__(ids[r] + (pos - starts[r]));
+    }
+    /*
+     Same as above, but `r` is the index for a run at or before the one that
+     contains `pos`, and it's updated to the one that does.
+     This avoids binary searches when sites are accessed in increasing order
+     (start with `r = 0`).
+     */
+    inline uint8 get(const uint64& pos, uint64& r) const {
+        while ((r + 1) < starts.size() && starts[r+1] <= pos) r++;
+        return category__(ids[r] + (pos - starts[r]));
+    }
+
+    /*
+     Insert `size` new sites (with IDs starting at `id`) before position `pos`.
+     This is O(number of runs) unless `pos` is at the end.
+     */
+    void insert(const uint64& pos, const uint64& size, const uint64& id) {
+        if (size == 0) return;
+        uint64 r = split__(pos);
+        starts.insert(starts.begin() + r, pos);
+        ids.insert(ids.begin() + r, id);
+        for (uint64 k = r + 1; k < starts.size(); k++) starts[k] += size;
+        n_sites += size;
+        return;
+    }
+
+    /*
+     Remove `size` sites starting at position `pos`.
+     This is O(number of runs) unless these sites are at the end.
+     */
+    void erase(const uint64& pos, uint64 size) {
+        if (pos >= n_sites) return;
+        if (size > (n_sites - pos)) size = n_sites - pos;
+        if (size == 0) return;
+        uint64 r1 = split__(pos);
+        uint64 r2 = split__(pos + size);
+        starts.erase(starts.begin() + r1, starts.begin() + r2);
+        ids.erase(ids.begin() + r1, ids.begin() + r2);
+        for (uint64 k = r1; k < starts.size(); k++) starts[k] -= size;
+        n_sites -= size;
+        return;
+    }
+
+    // Add `size` sites from `other`, starting at its position `pos`, to the end
+    void append(const SiteRates& other, const uint64& pos, const uint64& size) {
+        if (size == 0) return;
+        uint64 r = other.run__(pos);
+        uint64 p = pos;
+        while (p < (pos + size)) {
+            uint64 id = other.ids[r] + (p - other.starts[r]);
+            // Don't start a new run if the IDs continue from the last one:
+            if (ids.empty() || (ids.back() + (n_sites - starts.back())) != id) {
+                starts.push_back(n_sites);
+                ids.push_back(id);
+            }
+            uint64 run_end = ((r + 1) < other.starts.size()) ?
+                other.starts[r+1] : other.n_sites;
+            uint64 n = std::min(run_end, pos + size) - p;
+            n_sites += n;
+            p += n;
+            r++;
+        }
+        return;
+    }
+
+    /*
+     Adjust for a batch of indels (see `HapChrom::add_indels`), where these sites
+     start at position `begin` on the chromosome.
+     Like `HapChrom::add_indels`, this builds a new set of runs from front to back,
+     so each indel only changes the last few runs, and the whole batch takes
+     O(number of runs + number of indels) time.
+     Each insertion uses one draw from `eng` for its IDs.
+     */
+    void add_indels(const std::vector<Indel>& indels, const uint64& begin, pcg64& eng) {
+
+        if (indels.empty()) return;
+
+        SiteRates out;
+        out.seed = seed;
+        out.n_gammas = n_gammas;
+        out.inv_thresh = inv_thresh;
+
+        // Next site in this object that hasn't been moved to `out`:
+        uint64 site_i = 0;
+
+        for (const Indel& indel : indels) {
+            const uint64 pos = indel.pos - begin;
+            // Number of sites that need to be in `out` before adding this indel:
+            uint64 n_needed = pos + (indel.insertion ? 1 : indel.size);
+            if (n_needed > out.n_sites) {
+                uint64 n = std::min(n_needed - out.n_sites, n_sites - site_i);
+                out.append(*this, site_i, n);
+                site_i += n;
+            }
+            if (indel.insertion) {
+                // New sites go after the original `pos`:
+                out.insert(pos + 1, indel.size, eng());
+            } else out.erase(pos, indel.size);
+        }
+
+        out.append(*this, site_i, n_sites - site_i);
+
+        *this = std::move(out);
+
+        return;
+    }
+
+private:
+
+    std::vector<uint64> starts;  // position of the first site in each run
+    std::vector<uint64> ids;     // ID of the first site in each run
+    uint64 n_sites;
+    uint64 seed;
+    uint8 n_gammas;
+    uint64 inv_thresh;           // invariant probability, scaled by 2^32
+
+    // Index for the run that contains `pos`
+    inline uint64 run__(const uint64& pos) const {
+        return std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin() - 1;
+    }
+
+    /*
+     Make sure a run starts at `pos` and return its index
+     (or the number of runs if `pos` is at or past the end).
+     */
+    uint64 split__(const uint64& pos) {
+        if (pos >= n_sites) return starts.size();
+        uint64 r = run__(pos);
+        if (starts[r] == pos) return r;
+        starts.insert(starts.begin() + r + 1, pos);
+        ids.insert(ids.begin() + r + 1, ids[r] + (pos - starts[r]));
+        return r + 1;
+    }
+
+    /*
+     The low 32 bits of the hash decide whether a site is invariant, and the high
+     32 bits choose the Gamma category.
+     */
+    inline uint8 category__(const uint64& id) const {
+        uint64 h = mix64(seed + (id + 1) * 0x9E3779B97F4A7C15ULL);
+        if ((h & 0xFFFFFFFFULL) < inv_thresh) return n_gammas;
+        return static_cast<uint8>(((h >> 32) * n_gammas) >> 32);
+    }
+
+};
+
+
+
+
+
+/*
+ Substitution probabilities and samplers for one branch length, for all rate
+ categories.
+ */
+struct SubMats {
+
+    // Samplers for the new nucleotide, conditional on a substitution occurring:
+    std::vector<std::array<FixedAliasSampler<4>, 4>> samplers;
+    // Probabilities that a substitution occurs, by rate category and nucleotide:
+    std::vector<NtVector> sub_probs;
+    // Maximum of `sub_probs`, used to jump between candidate sites:
+    double max_sub_prob;
+
+    SubMats(const uint64& n_cats)
+        : samplers(n_cats),
+          sub_probs(n_cats, NtVector{{0, 0, 0, 0}}),
+          max_sub_prob(0) {}
+
+};
+
+
+/*
+ Stores `SubMats` objects by branch length so that chromosomes (and chromosome
+ segments) evolving along the same tree don't each re-calculate P(t) and
+ re-build the alias samplers for every edge.
+ One of these is made for each substitution model and is shared among all
+ copies of its `SubMutator`, including ones used by different threads.
+
+ Only one thread makes the matrices for a given branch length; others asking
+ for it at the same time wait for it to finish.
+ Matrices are handed out as `std::shared_ptr<const SubMats>`, so they stay
+ valid for as long as a thread holds onto them.
+ When the cache has more than `max_cats` (branch length, rate category)
+ combinations, it's emptied before adding the next one.
+ */
+class SubMatsCache {
+
+public:
+
+    typedef std::shared_ptr<const SubMats> MatsPtr;
+
+    SubMatsCache(const uint64& n_cats_,
+                 const uint64& max_cats_ = jlp::sub_mats_cache_cats)
+        : n_cats(std::max(n_cats_, static_cast<uint64>(1))),
+          max_cats(max_cats_),
+          entries(),
+          mtx() {}
+
+    // This class isn't meant to be copied; share it using a `shared_ptr` instead.
+    SubMatsCache(const SubMatsCache&) = delete;
+    SubMatsCache& operator=(const SubMatsCache&) = delete;
+
+    /*
+     Get matrices for branch length `b_len`, using `make(b_len)` to create them
+     if they're not already here.
+     */
+    template <typename F>
+    MatsPtr get(const double& b_len, const F& make) {
+
+        std::shared_ptr<Entry> entry;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto iter = entries.find(b_len);
+            if (iter != entries.end()) {
+                entry = iter->second;
+            } else {
+                // (Entries in use stay alive through their `shared_ptr`s)
+                if (((entries.size() + 1) * n_cats) > max_cats) entries.clear();
+                entry = std::make_shared<Entry>();
+                entries[b_len] = entry;
+            }
+        }
+
+        std::call_once(entry->made, [&]() {
+            entry->mats = make(b_len);
+        });
+
+        return entry->mats;
+    }
+
+private:
+
+    struct Entry {
+        std::once_flag made;
+        MatsPtr mats;
+        Entry() : made(), mats() {};
+    };
+
+    uint64 n_cats;
+    uint64 max_cats;
+    std::unordered_map<double, std::shared_ptr<Entry>> entries;
+    std::mutex mtx;
+
+};
+
 
 
 
@@ -45,26 +379,32 @@ class SubMutator {
 
 public:
 
-    std::vector<arma::mat> Q;
-    std::vector<arma::mat> U;
-    std::vector<arma::mat> Ui;
-    std::vector<arma::vec> L;
+    // Matrices for each Gamma category (`U`, `Ui`, and `L` are empty for UNREST):
+    std::vector<NtMatrix> Q;
+    std::vector<NtMatrix> U;
+    std::vector<NtMatrix> Ui;
+    std::vector<NtVector> L;
     double invariant;
     const std::vector<uint8> char_map = make_char_map();
-    std::vector<std::vector<AliasSampler>> samplers;
-    std::vector<arma::mat> Pt;
+    // Matrices by branch length, shared with all copies of this object:
+    std::shared_ptr<SubMatsCache> mats_cache;
 
 
-    SubMutator() {}
+    SubMutator()
+        : invariant(0), mats_cache(), site_var(false),
+          subs_kernel(choose_kernel(false, false, false)),
+          dense_kernel(choose_kernel(false, false, true)) {}
     SubMutator(const std::vector<arma::mat>& Q_,
                const std::vector<arma::mat>& U_,
                const std::vector<arma::mat>& Ui_,
                const std::vector<arma::vec>& L_,
                const double& invariant_)
-        : Q(Q_), U(U_), Ui(Ui_), L(L_), invariant(invariant_),
-          samplers(Q_.size(), std::vector<AliasSampler>(4)),
-          Pt(Q_.size(), arma::mat(4,4)),
-          site_var(((invariant_ > 0) || (Q_.size() > 1)) ? true : false) {
+        : Q(Q_.begin(), Q_.end()), U(U_.begin(), U_.end()),
+          Ui(Ui_.begin(), Ui_.end()), L(), invariant(invariant_),
+          mats_cache(std::make_shared<SubMatsCache>(Q_.size())),
+          site_var(((invariant_ > 0) || (Q_.size() > 1)) ? true : false),
+          subs_kernel(choose_kernel(site_var, invariant_ > 0, false)),
+          dense_kernel(choose_kernel(site_var, invariant_ > 0, true)) {
 #ifdef __JACKALOPE_DEBUG
         if (Q_.size() == 0) stop("in SubMutator constr, Q_.size() == 0");
         if (Q_.size() > 255) stop("in SubMutator constr, Q_.size() > 255");
@@ -72,13 +412,16 @@ public:
         if (Ui_.size() > 255) stop("in SubMutator constr, Ui_.size() > 255");
         if (L_.size() > 255) stop("in SubMutator constr, L_.size() > 255");
 #endif
+        L.reserve(L_.size());
+        for (const arma::vec& l : L_) L.push_back(to_nt_vector(l));
     }
 
 
     SubMutator(const SubMutator& other)
         : Q(other.Q), U(other.U), Ui(other.Ui), L(other.L), invariant(other.invariant),
-          samplers(other.samplers), Pt(other.Pt),
-          site_var(other.site_var) {};
+          mats_cache(other.mats_cache),
+          site_var(other.site_var), subs_kernel(other.subs_kernel),
+          dense_kernel(other.dense_kernel) {};
 
     SubMutator& operator=(const SubMutator& other) {
         Q = other.Q;
@@ -86,75 +429,71 @@ public:
         Ui = other.Ui;
         L = other.L;
         invariant = other.invariant;
-        samplers = other.samplers;
-        Pt = other.Pt;
+        mats_cache = other.mats_cache;
         site_var = other.site_var;
+        subs_kernel = other.subs_kernel;
+        dense_kernel = other.dense_kernel;
         return *this;
     }
 
 
     int new_rates(const uint64& begin,
                   const uint64& end,
-                  std::deque<uint8>& rate_inds,
+                  SiteRates& rate_inds,
                   pcg64& eng,
                   Progress& prog_bar);
 
     int add_subs(const double& b_len,
                  const uint64& begin,
                  const uint64& end,
-                 const std::deque<uint8>& rate_inds,
+                 const SiteRates& rate_inds,
                  HapChrom& hap_chrom,
                  pcg64& eng,
                  Progress& prog_bar);
 
     // Adjust rate_inds for indels:
     void deletion_adjust(const uint64& size, uint64 pos, const uint64& begin,
-                         std::deque<uint8>& rate_inds);
+                         SiteRates& rate_inds);
     void insertion_adjust(const uint64& size, uint64 pos, const uint64& begin,
-                          std::deque<uint8>& rate_inds, pcg64& eng);
+                          SiteRates& rate_inds, pcg64& eng);
+    // ... and for a batch of indels:
+    void indels_adjust(const std::vector<Indel>& indels, const uint64& begin,
+                       SiteRates& rate_inds, pcg64& eng);
 
 
 private:
 
     bool site_var; // for whether to include among-site variability
 
-    inline void adjust_mats(const double& b_len);
-
-    inline void subs_before_muts__(const uint64& pos,
-                                   uint64& mut_i,
-                                   const std::string& bases,
-                                   const uint8& rate_i,
-                                   HapChrom& hap_chrom,
-                                   pcg64& eng);
-    inline int subs_before_muts(const uint64& begin,
-                                const uint64& end,
-                                uint64& mut_i,
-                                const uint8& max_gamma,
-                                const std::string& bases,
-                                const std::deque<uint8>& rate_inds,
-                                HapChrom& hap_chrom,
-                                pcg64& eng,
-                                Progress& prog_bar,
-                                uint32& iters);
-
-    inline void subs_after_muts__(const uint64& pos,
-                                  uint64& mut_i,
-                                  const std::string& bases,
-                                  const uint8& rate_i,
-                                  HapChrom& hap_chrom,
-                                  pcg64& eng);
-    inline int subs_after_muts(uint64& pos,
-                               const uint64& begin,
-                               const uint64& end1,
-                               const uint64& end2,
-                               uint64& mut_i,
-                               const uint8& max_gamma,
-                               const std::string& bases,
-                               const std::deque<uint8>& rate_inds,
-                               HapChrom& hap_chrom,
-                               pcg64& eng,
-                               Progress& prog_bar,
-                               uint32& iters);
+    /*
+     Versions of `add_subs_` for this object's rate categories, chosen once at
+     construction so that the loop over sites doesn't have to check them.
+     There's one for regions with few mutations and one for densely
+     mutated regions.
+     */
+    typedef int (SubMutator::*SubsKernel)(const SubMats&, const uint64&,
+                 const uint64&, const SiteRates&, HapChrom&, pcg64&, Progress&);
+    SubsKernel subs_kernel;
+    SubsKernel dense_kernel;
+
+    static SubsKernel choose_kernel(const bool& site_var_, const bool& invariant_,
+                                    const bool& dense_);
+
+    SubMatsCache::MatsPtr make_mats(const double& b_len) const;
+
+    template <bool site_var_, bool invariant_, bool dense_>
+    int add_subs_(const SubMats& mats,
+                  const uint64& begin,
+                  const uint64& end,
+                  const SiteRates& rate_inds,
+                  HapChrom& hap_chrom,
+                  pcg64& eng,
+                  Progress& prog_bar);
+
+    inline void sub_one_site_(const uint64& pos,
+                              uint64& n_before,
+                              const char& nucleo,
+                              HapChrom& hap_chrom);
 
 
 
@@ -172,31 +511,40 @@ private:
 //'
 //' @noRd
 //'
-inline void Pt_calc(const arma::mat& U,
-                    const arma::mat& Ui,
-                    const arma::vec& L,
+inline void Pt_calc(const NtMatrix& U,
+                    const NtMatrix& Ui,
+                    const NtVector& L,
                     const double& t,
-                    arma::mat& Pt) {
+                    NtMatrix& Pt) {
 
-    arma::mat diag_L = arma::diagmat(arma::exp(L * t));
+    NtVector exp_L;
+    for (uint32 k = 0; k < 4; k++) exp_L[k] = std::exp(L[k] * t);
 
-    Pt = U * diag_L * Ui;
+    for (uint32 i = 0; i < 4; i++) {
+        for (uint32 j = 0; j < 4; j++) {
+            double p = 0;
+            for (uint32 k = 0; k < 4; k++) p += U(i, k) * exp_L[k] * Ui(k, j);
+            Pt(i, j) = p;
+        }
+    }
 
     return;
 }
 
-//' Calculating P(t) using repeated matrix squaring, for UNREST model only.
+//' Calculating P(t) using scaling and repeated matrix squaring, for UNREST model only.
 //'
 //' @noRd
 //'
-inline void Pt_calc(const arma::mat& Q,
+inline void Pt_calc(const NtMatrix& Q,
                     const uint32& k,
                     const double& t,
-                    arma::mat& Pt) {
+                    NtMatrix& Pt) {
 
     double m = static_cast<double>(1U<<k);
 
-    Pt = arma::eye<arma::mat>(4, 4) + Q * t / m + 0.5 * (Q * t / m) * (Q * t / m);
+    NtMatrix Qtm = Q * (t / m);
+
+    Pt = NtMatrix::identity() + Qtm + (Qtm * Qtm) * 0.5;
 
     for (uint32 i = 0; i < k; i++) Pt = Pt * Pt;
 
@@ -0,0 +1,108 @@
+#ifndef __JACKALOPE_NT_MATRIX_H
+#define __JACKALOPE_NT_MATRIX_H
+
+
+#include "jackalope_config.h" // controls debugging and diagnostics output
+
+/*
+ ********************************************************
+
+ Fixed-size 4x4 matrices for nucleotide substitution models.
+ These live on the stack, so unlike `arma::mat`, no memory is allocated when
+ they're created or multiplied.
+
+ ********************************************************
+ */
+
+#include <RcppArmadillo.h>
+#include <array>  // array class
+
+#include "jackalope_types.h"  // integer types
+#include "util.h"  // str_stop
+
+
+using namespace Rcpp;
+
+
+
+// Vector with one item per nucleotide (T, C, A, then G)
+typedef std::array<double, 4> NtVector;
+
+
+/*
+ 4x4 matrix, with rows and columns in the order T, C, A, G.
+ Elements are stored in row-major order so that a row of a P(t) matrix
+ (i.e., the probabilities for one starting nucleotide) is contiguous.
+ */
+class NtMatrix {
+
+public:
+
+    std::array<double, 16> x;
+
+    // Starts out as all zeros
+    NtMatrix() : x() {}
+    explicit NtMatrix(const arma::mat& M) : x() {
+        if (M.n_rows != 4 || M.n_cols != 4) {
+            str_stop({"\nNtMatrix can only be made from a 4x4 matrix, ",
+                     "but this one is ", std::to_string(M.n_rows), "x",
+                     std::to_string(M.n_cols), "."});
+        }
+        for (uint32 i = 0; i < 4; i++) {
+            for (uint32 j = 0; j < 4; j++) x[i*4+j] = M(i, j);
+        }
+    }
+
+    static NtMatrix identity() {
+        NtMatrix I;
+        for (uint32 i = 0; i < 4; i++) I.x[i*5] = 1;
+        return I;
+    }
+
+    inline double& operator()(const uint32& i, const uint32& j) {
+        return x[i*4+j];
+    }
+    inline const double& operator()(const uint32& i, const uint32& j) const {
+        return x[i*4+j];
+    }
+
+    inline NtMatrix operator*(const NtMatrix& other) const {
+        NtMatrix out;
+        for (uint32 i = 0; i < 4; i++) {
+            for (uint32 k = 0; k < 4; k++) {
+                const double& a(x[i*4+k]);
+                for (uint32 j = 0; j < 4; j++) out.x[i*4+j] += a * other.x[k*4+j];
+            }
+        }
+        return out;
+    }
+
+    inline NtMatrix operator*(const double& s) const {
+        NtMatrix out(*this);
+        for (double& v : out.x) v *= s;
+        return out;
+    }
+
+    inline NtMatrix operator+(const NtMatrix& other) const {
+        NtMatrix out(*this);
+        for (uint32 i = 0; i < 16; i++) out.x[i] += other.x[i];
+        return out;
+    }
+
+};
+
+
+// Convert vector of length 4 to an `NtVector`
+inline NtVector to_nt_vector(const arma::vec& v) {
+    if (v.n_elem != 4) {
+        str_stop({"\nNtVector can only be made from a vector of length 4, ",
+                 "but this one has length ", std::to_string(v.n_elem), "."});
+    }
+    NtVector out;
+    for (uint32 i = 0; i < 4; i++) out[i] = v(i);
+    return out;
+}
+
+
+
+#endif
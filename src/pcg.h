@@ -6,6 +6,7 @@
 #include <RcppArmadillo.h>
 #include <vector>
 #include <string>
+#include <array>  // array class (for RngBuffer)
 #include "pcg/pcg_extras.hpp"  // pcg 128-bit integer type
 #include <pcg/pcg_random.hpp> // pcg prng
 
@@ -18,7 +19,13 @@ using namespace Rcpp;
 
 
 namespace pcg {
-    const long double max64 = static_cast<long double>(pcg64::max());
+    const double inv_2_52 = 1.0 / 4503599627370496.0;  // 2^-52
+    const float inv_2_23f = 1.0f / 8388608.0f;  // 2^-23
+}
+
+namespace jlp {
+    // Number of draws per block in `RngBuffer`
+    const uint64 rng_buffer_size = 64;
 }
 
 
@@ -33,18 +40,6 @@ namespace pcg {
 
 
 
-// To sample for seeds before multi-thread operations
-inline std::vector<std::vector<uint64>> mt_seeds(const uint64& n_threads) {
-
-    std::vector<std::vector<uint64>> sub_seeds(n_threads, std::vector<uint64>(8));
-
-    for (uint64 i = 0; i < n_threads; i++) {
-        sub_seeds[i] = as<std::vector<uint64>>(Rcpp::runif(8,0,4294967296));
-    }
-
-    return sub_seeds;
-}
-
 inline void fill_seeds(const std::vector<uint64>& sub_seeds,
                          uint128& seed1, uint128& seed2) {
 
@@ -86,6 +81,75 @@ inline pcg64 seeded_pcg(const std::vector<uint64>& sub_seeds) {
 
 
 
+/*
+ Independent RNG streams for units of work in parallel code.
+
+ One set of seeds is sampled (from R's RNG) when the object is created.
+ Each unit of work then gets its own engine from `engine(kind, i, j)`, whose
+ state is a hash of those seeds and the unit's key:
+ the kind of task (one of the `jlp::rng_*` constants below), plus one or two
+ indices (e.g., chromosome and tree, or block of reads).
+ Because an engine only depends on which unit of work it's for (not on which
+ thread does it or in what order), output doesn't change with the number of
+ threads or how work is scheduled among them.
+ */
+namespace jlp {
+    const uint64 rng_create_chroms = 1;
+    const uint64 rng_replace_Ns = 2;
+    const uint64 rng_ssites = 3;
+    const uint64 rng_evolve = 4;
+    const uint64 rng_reads = 5;
+}
+
+// Finalizer from splitmix64 (a bijection on 64-bit integers)
+inline uint64 mix64(uint64 x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+class RngStreams {
+public:
+
+    RngStreams() : key() {
+        std::vector<uint64> sub_seeds = as<std::vector<uint64>>(
+            Rcpp::runif(8,0,4294967296));
+        set_key__(sub_seeds);
+    }
+    // sub_seeds needs to be at least 8-long!
+    RngStreams(const std::vector<uint64>& sub_seeds) : key() {
+        set_key__(sub_seeds);
+    }
+
+    pcg64 engine(const uint64& kind, const uint64& i, const uint64& j = 0) const {
+        uint64 w[4];
+        for (uint64 k = 0; k < 4; k++) {
+            uint64 h = mix64(key[k] ^ mix64(kind + k * 0x9E3779B97F4A7C15ULL));
+            h = mix64(h ^ mix64(i + 0xBF58476D1CE4E5B9ULL));
+            h = mix64(h ^ mix64(j + 0x94D049BB133111EBULL));
+            w[k] = h;
+        }
+        uint128 seed1 = (static_cast<uint128>(w[0])<<64) + w[1];
+        uint128 seed2 = (static_cast<uint128>(w[2])<<64) + w[3];
+        pcg64 out(seed1, seed2);
+        return out;
+    }
+
+private:
+
+    uint64 key[4];
+
+    void set_key__(const std::vector<uint64>& sub_seeds) {
+        for (uint64 k = 0; k < 4; k++) {
+            key[k] = (sub_seeds[2*k]<<32) + sub_seeds[2*k+1];
+        }
+        return;
+    }
+
+};
+
+
+
 
 
 /*
@@ -95,17 +159,96 @@ inline pcg64 seeded_pcg(const std::vector<uint64>& sub_seeds) {
 
  ========================
  */
+/*
+ These convert raw 64-bit draws to uniform numbers using only the top bits and
+ a multiplication, which avoids slower `long double` arithmetic.
+ Adding 0.5 keeps results inside the open interval (0,1), which is why they use
+ one fewer bit than the type's precision (otherwise the largest value would
+ round up to 1).
+ */
+// uniform in range (0,1) from 52 bits
+inline double bits_to_01(const uint64& bits) {
+    return (static_cast<double>(bits >> 12) + 0.5) * pcg::inv_2_52;
+}
+// uniform in range (0,1) from 23 bits
+inline float bits_to_01f(const uint64& bits) {
+    return (static_cast<float>(bits >> 41) + 0.5f) * pcg::inv_2_23f;
+}
+/*
+ Integer in range [0,n) from the top 32 bits.
+ This requires that `n <= 2^32`.
+ */
+inline uint64 bits_to_index(const uint64& bits, const uint64& n) {
+    return ((bits >> 32) * n) >> 32;
+}
+
 // uniform in range (0,1)
-inline long double runif_01(pcg64& eng) {
-    return (static_cast<long double>(eng()) + 1) / (pcg::max64 + 2);
+inline double runif_01(pcg64& eng) {
+    return bits_to_01(eng());
+}
+// uniform in range (0,1), but only with float precision
+inline float runif_01f(pcg64& eng) {
+    return bits_to_01f(eng());
 }
 // uniform in range (a,b)
-inline long double runif_ab(pcg64& eng, const long double& a, const long double& b) {
-    return a + ((static_cast<long double>(eng()) + 1) / (pcg::max64 + 2)) * (b - a);
+inline double runif_ab(pcg64& eng, const double& a, const double& b) {
+    return a + bits_to_01(eng()) * (b - a);
 }
 
 
 
 
+/*
+ Block of raw draws from a `pcg64` engine.
+ Filling many draws in one tight loop is faster than going back and forth
+ between the engine and the code using its output, so use this in loops that
+ take at least one random number per iteration.
+ Any draws not used when this object is destroyed are simply lost.
+ Only use one of these with a single engine, or call `reset` when switching
+ to a new one.
+ */
+class RngBuffer {
+public:
+
+    RngBuffer() : draws(), pos(jlp::rng_buffer_size) {};
+
+    // Raw 64-bit draw:
+    inline uint64 next(pcg64& eng) {
+        if (pos == jlp::rng_buffer_size) refill__(eng);
+        return draws[pos++];
+    }
+    // Uniform in range (0,1):
+    inline double unif_01(pcg64& eng) {
+        return bits_to_01(next(eng));
+    }
+    // Uniform in range (0,1), float precision:
+    inline float unif_01f(pcg64& eng) {
+        return bits_to_01f(next(eng));
+    }
+    // Integer in range [0,n) (requires `n <= 2^32`):
+    inline uint64 index(pcg64& eng, const uint64& n) {
+        return bits_to_index(next(eng), n);
+    }
+    // Discard unused draws (e.g., before using it with a new engine):
+    inline void reset() {
+        pos = jlp::rng_buffer_size;
+        return;
+    }
+
+private:
+
+    std::array<uint64, jlp::rng_buffer_size> draws;
+    uint64 pos;
+
+    inline void refill__(pcg64& eng) {
+        for (uint64& d : draws) d = eng();
+        pos = 0;
+        return;
+    }
+
+};
+
+
+
 
 #endif
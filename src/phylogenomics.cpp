@@ -13,8 +13,8 @@
 #include <RcppArmadillo.h>
 #include <vector>  // vector class
 #include <string>  // string class
-#include <algorithm>  // lower_bound, sort
-#include <deque>  // deque
+#include <algorithm>  // lower_bound, sort, min
+#include <utility>  // pair, move
 #include <progress.hpp>  // for the progress bar
 #ifdef _OPENMP
 #include <omp.h>  // omp
@@ -39,9 +39,8 @@ using namespace Rcpp;
 /*
  Process one phylogenetic tree for a single chromosome with no recombination.
 
- Note that this function should be changed if any of these HapChroms differ from
- each other (within the range specified if recombination = true).
- They can already have mutations, but to start out, they must all be the same.
+ The HapChroms in `tip_chroms` must all start out with no mutations
+ (see `evolve` below).
  */
 int PhyloOneChrom::one_tree(const uint64& idx,
                             pcg64& eng,
@@ -55,11 +54,10 @@ int PhyloOneChrom::one_tree(const uint64& idx,
 
     // Reset rates for tips:
     status = reset(tree, eng, prog_bar);
-    if (status < 0) return status;
+    if (status != 0) return status;
 
 
     uint64 b1, b2;
-    uint64 mut_i = 0;
     sint64 size_mod;
     double b_len;
 
@@ -88,8 +86,7 @@ int PhyloOneChrom::one_tree(const uint64& idx,
             /*
              Update HapChrom objects for this branch.
              */
-            if (idx > 0) mut_i = trees[idx - 1].mut_ends[b1];
-            size_mod = chrom2.add_to_back(chrom1, mut_i);
+            size_mod = chrom2.add_to_back(chrom1, 0);
 
             // Update end point for these new mutations:
             tree.ends[b2] += size_mod;
@@ -109,16 +106,10 @@ int PhyloOneChrom::one_tree(const uint64& idx,
 #endif
         status = mutator.mutate(b_len, chrom2, eng, prog_bar,
                                 tree.starts[b2], tree.ends[b2], rates[b2]);
-        if (status < 0) return status;
+        if (status != 0) return status;
 
     }
 
-    // Update indices (non-inclusive) for end of this tree's mutations in
-    // `HapChrom::mutations`:
-    for (uint64 i = 0; i < tree.n_tips; i++) {
-        tree.mut_ends[i] = tip_chroms[i]->mutations.size();
-    }
-
     // Update progress bar:
     prog_bar.increment(tree.end - tree.start + 1);
 
@@ -139,9 +130,6 @@ int PhyloOneChrom::reset(const PhyloTree& tree,
                          pcg64& eng,
                          Progress& prog_bar) {
 
-    const uint64& start(tree.start);
-    const uint64& end(tree.end);
-
     if (tree.n_tips == 0) {
         throw(Rcpp::exception("\n# tips == zero is non-sensical.", false));
     }
@@ -149,6 +137,10 @@ int PhyloOneChrom::reset(const PhyloTree& tree,
     // Create rates:
     if (rates.size() != n_tips) rates.resize(n_tips);
     uint64 root = tree.edges(0,0); // <-- should be index to root of tree
+    // (The root's range differs from `tree.start` and `tree.end` if indels
+    // occurred in previous trees)
+    const uint64& start(tree.starts[root]);
+    const uint64& end(tree.ends[root]);
     // Generate rates for root of tree (`status` is -1 if user interrupts process):
     int status = mutator.new_rates(start, end, rates[root], eng, prog_bar);
     // The rest of the nodes/tips will have rates based on parent nodes
@@ -222,32 +214,140 @@ void PhyloOneChrom::fill_tree_mutator(const List& genome_phylo_info,
 
 /*
  Evolve all trees.
+
+ Each tree is evolved on new HapChrom objects, and their mutations are then
+ added to the back of the ones in `tip_chroms`.
+ Because the new ones have no mutations, positions in them are the same as in
+ the reference chromosome, and indels in one tree's region can't merge with
+ mutations from another tree's region.
+ Mutation blocks are shared rather than copied when adding them
+ (see `AllMutations::append`), so this doesn't take much memory or time.
  */
 int PhyloOneChrom::evolve(pcg64& eng,
                           Progress& prog_bar) {
 
-    for (uint64 i = 0; i < trees.size(); i++) {
+    if (tip_chroms.empty()) return 0;
 
-        if (i > 0) {
-            for (uint64 j = 0; j < trees[i].ends.size(); j++) {
-                trees[i].starts[j] = trees[i-1].ends[j];
-                trees[i].ends[j] = trees[i-1].ends[j] + trees[i].end - trees[i-1].end;
-            }
-        }
+    const RefChrom& ref_chrom(*(tip_chroms.front()->ref_chrom));
+    const HapChrom blank(ref_chrom);
+    std::vector<HapChrom*> out_chroms(tip_chroms);
+    std::vector<HapChrom> tree_chroms(out_chroms.size(), blank);
+    for (uint64 j = 0; j < tree_chroms.size(); j++) tip_chroms[j] = &tree_chroms[j];
+
+    int status = 0;
+
+    for (uint64 i = 0; i < trees.size(); i++) {
 
 #ifdef __JACKALOPE_DIAGNOSTICS
         Rcout << "-- tree " << i << std::endl;
 #endif
 
-        int status = one_tree(i, eng, prog_bar);
-        if (status < 0) return status;
+        status = one_tree(i, eng, prog_bar);
+        if (status != 0) break;
+
+        for (uint64 j = 0; j < tree_chroms.size(); j++) {
+            out_chroms[j]->add_to_back(tree_chroms[j], 0);
+            tree_chroms[j] = blank;  // (keeps memory allocated)
+        }
     }
 
-    return 0;
+    tip_chroms = out_chroms;
+
+    return status;
+}
+
+
+
+
+
+
+/*
+ Split into segments of consecutive trees that can be evolved at the same time.
+ */
+std::vector<PhyloOneChrom> PhyloOneChrom::split(const uint64& segment_size) {
+
+    std::vector<PhyloOneChrom> segments;
+
+    // Cut trees longer than `segment_size` into pieces:
+    std::vector<PhyloTree> pieces;
+    pieces.reserve(trees.size());
+    for (PhyloTree& tree : trees) {
+        if (segment_size == 0 || (tree.end - tree.start) <= segment_size) {
+            pieces.push_back(std::move(tree));
+            continue;
+        }
+        for (uint64 start_ = tree.start; start_ < tree.end; start_ += segment_size) {
+            pieces.push_back(tree);
+            PhyloTree& piece(pieces.back());
+            piece.start = start_;
+            piece.end = std::min(start_ + segment_size, tree.end);
+            piece.starts.assign(n_tips, piece.start);
+            piece.ends.assign(n_tips, piece.end);
+        }
+    }
+    trees.clear();
+
+    // Group pieces into segments:
+    uint64 i = 0;
+    while (i < pieces.size()) {
+        segments.emplace_back();
+        PhyloOneChrom& seg(segments.back());
+        seg.rates.resize(n_tips);
+        seg.mutator = mutator;
+        seg.n_tips = n_tips;
+        uint64 seg_size = 0;
+        do {
+            seg_size += pieces[i].end - pieces[i].start;
+            seg.trees.push_back(std::move(pieces[i]));
+            i++;
+        } while (i < pieces.size() && seg.trees.size() < jlp::max_segment_trees &&
+            (segment_size == 0 || seg_size < segment_size));
+        seg.recombination = seg.trees.size() > 1;
+    }
+
+    return segments;
 }
 
 
 
+/*
+ Evolve one segment from `split` on its own HapChrom objects.
+ */
+int PhyloOneChrom::evolve_segment(const RefChrom& ref_chrom,
+                                  pcg64& eng,
+                                  Progress& prog_bar) {
+
+    seg_chroms.assign(n_tips, HapChrom(ref_chrom));
+    tip_chroms.clear();
+    tip_chroms.reserve(n_tips);
+    for (HapChrom& hc : seg_chroms) tip_chroms.push_back(&hc);
+
+    return evolve(eng, prog_bar);
+}
+
+
+
+/*
+ Add mutations from evolved segments to this object's HapChrom objects.
+ Blocks of mutations are shared rather than copied (see `AllMutations::append`),
+ so this doesn't take much memory or time.
+ */
+void PhyloOneChrom::merge(std::vector<PhyloOneChrom>& segments) {
+
+    for (PhyloOneChrom& seg : segments) {
+        // (Segments are missing HapChrom objects if the user interrupted evolution)
+        if (seg.seg_chroms.size() != tip_chroms.size()) break;
+        for (uint64 i = 0; i < tip_chroms.size(); i++) {
+            tip_chroms[i]->add_to_back(seg.seg_chroms[i], 0);
+        }
+        seg.tip_chroms.clear();
+        clear_memory<std::vector<HapChrom>>(seg.seg_chroms);
+    }
+
+    return;
+}
+
+
 
 
 
@@ -279,6 +379,7 @@ PhyloInfo::PhyloInfo(const List& genome_phylo_info, const TreeMutator& mutator_b
 */
 XPtr<HapSet> PhyloInfo::evolve_chroms(
         SEXP& ref_genome_ptr,
+        const uint64& segment_size,
         const uint64& n_threads,
         const bool& show_progress) {
 
@@ -302,46 +403,73 @@ XPtr<HapSet> PhyloInfo::evolve_chroms(
         throw(Rcpp::exception(err_msg.c_str(), false));
     }
 
-    // Generate seeds for random number generators (1 RNG per thread)
-    const std::vector<std::vector<uint64>> seeds = mt_seeds(n_threads);
+    /*
+     Split chromosomes into segments that are evolved separately, then combined.
+     Tasks are chromosome and segment indices, done from most to least expensive.
+     */
+    std::vector<std::vector<PhyloOneChrom>> segments(n_chroms);
+    std::vector<std::pair<uint64,uint64>> tasks;
+    std::vector<double> costs;
+    for (uint64 i = 0; i < n_chroms; i++) {
+        segments[i] = phylo_one_chroms[i].split(segment_size);
+        for (uint64 j = 0; j < segments[i].size(); j++) {
+            tasks.push_back(std::make_pair(i, j));
+            costs.push_back(segments[i][j].cost());
+        }
+    }
+    const std::vector<uint64> order = cost_order(costs);
+
+    // RNG streams (1 per segment, so output doesn't depend on # threads)
+    const RngStreams streams;
 
 #ifdef _OPENMP
 #pragma omp parallel default(shared) num_threads(n_threads) if (n_threads > 1)
 {
 #endif
 
-    std::vector<uint64> active_seeds;
-
-    // Write the active seed per thread or just write one of the seeds.
 #ifdef _OPENMP
     uint64 active_thread = omp_get_thread_num();
 #else
     uint64 active_thread = 0;
 #endif
     int& status_code(status_codes[active_thread]);
-    active_seeds = seeds[active_thread];
-
-    pcg64 eng = seeded_pcg(active_seeds);
 
     // Parallelize the Loop
 #ifdef _OPENMP
-#pragma omp for schedule(static)
+#pragma omp for schedule(dynamic)
 #endif
-    for (uint64 i = 0; i < n_chroms; i++) {
+    for (uint64 k = 0; k < tasks.size(); k++) {
 
         if (status_code != 0) continue;
 
+        const uint64& i(tasks[order[k]].first);
+        const uint64& j(tasks[order[k]].second);
+
+        pcg64 eng = streams.engine(jlp::rng_evolve, i, j);
+
 #ifdef __JACKALOPE_DIAGNOSTICS
-        Rcout << std::endl << ">> chrom " << i << std::endl;
+        Rcout << std::endl << ">> chrom " << i << ", segment " << j << std::endl;
 #endif
 
+        // Evolve the segment:
+        status_code = segments[i][j].evolve_segment((*ref_genome)[i], eng, prog_bar);
+
+    }
+
+    // Combine segments into haplotype chromosomes:
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (uint64 i = 0; i < n_chroms; i++) {
+
+        if (status_code != 0 || prog_bar.is_aborted()) continue;
+
         PhyloOneChrom& chrom_phylo(phylo_one_chroms[i]);
 
         // Set values for haplotype info:
         chrom_phylo.set_hap_info(*hap_set, i);
 
-        // Evolve the chromosome using the chrom_phylo object:
-        status_code = chrom_phylo.evolve(eng, prog_bar);
+        chrom_phylo.merge(segments[i]);
 
     }
 
@@ -349,6 +477,13 @@ XPtr<HapSet> PhyloInfo::evolve_chroms(
 }
 #endif
 
+    for (const int& status_code : status_codes) {
+        if (status_code > 0) {
+            prog_bar.cleanup();
+            str_stop({"\nExact indel simulation (`epsilon = 0`) ran out of ",
+                     "room to store indels. Use `epsilon > 0` instead."});
+        }
+    }
     for (const int& status_code : status_codes) {
         if (status_code == -1) {
             prog_bar.cleanup();
@@ -386,6 +521,7 @@ SEXP evolve_across_trees(
         const arma::vec& deletion_rates,
         const double& epsilon,
         const std::vector<double>& pi_tcag,
+        const uint64& segment_size,
         uint64 n_threads,
         const bool& show_progress) {
 
@@ -410,7 +546,7 @@ SEXP evolve_across_trees(
      Now that we have tree(s) and mutator info, we can create haplotypes:
      */
 
-    XPtr<HapSet> hap_set = phylo_info.evolve_chroms(ref_genome_ptr,
+    XPtr<HapSet> hap_set = phylo_info.evolve_chroms(ref_genome_ptr, segment_size,
                                                     n_threads, show_progress);
 
 
@@ -17,7 +17,6 @@
 #include <vector>  // vector class
 #include <string>  // string class
 #include <algorithm>  // lower_bound, sort
-#include <deque>  // deque
 #include <random>  // exponential_distribution
 #include <progress.hpp>  // for the progress bar
 #ifdef _OPENMP
@@ -34,6 +33,16 @@
 using namespace Rcpp;
 
 
+namespace jlp {
+    /*
+     Maximum # trees in a chromosome segment that's evolved as one task.
+     With recombination, this lets regions with different gene trees be evolved
+     at the same time.
+     Tree regions are always evolved separately, so this doesn't affect the model.
+     */
+    const uint64 max_segment_trees = 100;
+}
+
 
 
 
@@ -54,8 +63,6 @@ struct PhyloTree {
     uint64 end;
     std::vector<uint64> starts;  // (inclusive) `start` values for each tree tip
     std::vector<uint64> ends;  // (non-inclusive) `end` values for each tree tip
-    // Indices (non-inclusive) for end of this tree's mutations in `HapChrom::mutations`:
-    std::vector<uint64> mut_ends;
     uint64 n_tips;             // # tips = # haplotypes
     uint64 n_edges;            // # edges = # connections between nodes/tips
 
@@ -74,7 +81,6 @@ struct PhyloTree {
           end(end_),
           starts(tip_labels_.size(), start_),
           ends(tip_labels_.size(), end_),
-          mut_ends(tip_labels_.size(), 0),
           n_tips(tip_labels_.size()),
           n_edges(edges_.n_rows) {
 
@@ -84,8 +90,10 @@ struct PhyloTree {
     PhyloTree(const PhyloTree& other)
         : branch_lens(other.branch_lens), edges(other.edges),
           tip_labels(other.tip_labels), start(other.start), end(other.end),
-          starts(other.starts), ends(other.ends), mut_ends(other.mut_ends),
+          starts(other.starts), ends(other.ends),
           n_tips(other.n_tips), n_edges(other.n_edges) {}
+    PhyloTree(PhyloTree&& other) = default;
+    PhyloTree& operator=(PhyloTree&& other) = default;
 
     PhyloTree& operator=(const PhyloTree& other) {
         branch_lens = other.branch_lens;
@@ -95,7 +103,6 @@ struct PhyloTree {
         end = other.end;
         starts = other.starts;
         ends = other.ends;
-        mut_ends = other.mut_ends;
         n_tips = other.n_tips;
         n_edges = other.n_edges;
         return *this;
@@ -120,7 +127,7 @@ class PhyloOneChrom {
 public:
     std::vector<PhyloTree> trees;
     std::vector<HapChrom*> tip_chroms;      // pointers to final HapChrom objects
-    std::vector<std::deque<uint8>> rates;   // rate indices (Gammas + invariants) for tree
+    std::vector<SiteRates> rates;           // rate indices (Gammas + invariants) for tree
     TreeMutator mutator;                    // to do the mutation additions across tree
     uint64 n_tips;                          // number of tips (i.e., haplotypes)
 
@@ -186,12 +193,54 @@ public:
     }
 
 
+    /*
+     Expected relative cost of evolving this chromosome:
+     the sum of each tree's region size times its total tree length.
+     */
+    double cost() const {
+        double out = 0;
+        for (const PhyloTree& tree : trees) {
+            double tree_len = 0;
+            for (const double& bl : tree.branch_lens) tree_len += bl;
+            out += static_cast<double>(tree.end - tree.start) * tree_len;
+        }
+        return out;
+    }
+
+
     /*
      Evolve all trees.
      */
     int evolve(pcg64& eng, Progress& prog_bar);
 
 
+    /*
+     Split into segments of consecutive trees that can be evolved at the same time.
+     Trees longer than `segment_size` are first cut into pieces no longer
+     than it, then pieces are grouped until a segment reaches `segment_size` bases
+     or has `jlp::max_segment_trees` trees.
+     If `segment_size` is zero, trees are never cut, so segments only differ
+     in how trees are grouped.
+     Trees are moved into the segments, so this object's `trees` are left empty.
+     */
+    std::vector<PhyloOneChrom> split(const uint64& segment_size);
+
+    /*
+     Evolve one segment from `split` on its own HapChrom objects, which are
+     based on `ref_chrom`.
+     Because these start with no mutations, positions are the same as in
+     the reference.
+     */
+    int evolve_segment(const RefChrom& ref_chrom, pcg64& eng, Progress& prog_bar);
+
+    /*
+     Add mutations from evolved segments (in order) to this object's HapChrom
+     objects, then clear the segments' HapChrom objects.
+     `set_hap_info` must be run first.
+     */
+    void merge(std::vector<PhyloOneChrom>& segments);
+
+
 
     /*
      Fill tree and mutator info from an input list and base mutator object
@@ -206,6 +255,8 @@ private:
 
 
     bool recombination;
+    std::vector<HapChrom> seg_chroms;       // HapChrom objects for a segment
+
 
 
     /*
@@ -242,6 +293,7 @@ public:
               const TreeMutator& mutator_base);
 
     XPtr<HapSet> evolve_chroms(SEXP& ref_genome_ptr,
+                               const uint64& segment_size,
                                const uint64& n_threads,
                                const bool& show_progress);
 
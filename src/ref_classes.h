@@ -18,6 +18,7 @@
 #include <vector>  // vector class
 #include <string>  // string class
 #include <deque>  // deque class
+#include <cstring>  // memcpy
 
 #include "jackalope_types.h"  // integer types
 #include "util.h"  // clear_memory, get_width
@@ -109,8 +110,8 @@ struct RefChrom {
         }
         // Make sure the read is long enough (this fxn should never shorten it):
         if (read.size() < n_to_add + read_start) read.resize(n_to_add + read_start, 'N');
-        for (uint64 i = 0; i < n_to_add; i++) {
-            read[(read_start + i)] = nucleos[(chrom_start + i)];
+        if (n_to_add > 0) {
+            std::memcpy(&read[read_start], nucleos.data() + chrom_start, n_to_add);
         }
         return;
     }
@@ -695,12 +695,9 @@ DataFrame view_mutations(SEXP hap_set_ptr, const uint64& hap_ind) {
         uint64 n_muts_i = hap_chrom.mutations.size();
         for (uint64 j = 0; j < n_muts_i; ++j) {
             size_mod.push_back(hap_chrom.size_modifier(j));
-            old_pos.push_back(hap_chrom.mutations.old_pos[j]);
-            new_pos.push_back(hap_chrom.mutations.new_pos[j]);
-            nucleos.push_back("");
-            if (hap_chrom.mutations.nucleos[j] != nullptr) {
-                nucleos.back() = std::string(hap_chrom.mutations.nucleos[j]);
-            }
+            old_pos.push_back(hap_chrom.mutations.old_pos(j));
+            new_pos.push_back(hap_chrom.mutations.new_pos(j));
+            nucleos.push_back(hap_chrom.mutations.get_nucleos(j));
             chroms.push_back(i);
         }
     }
@@ -760,11 +757,11 @@ List examine_mutations(SEXP hap_set_ptr, const uint64& hap_ind, const uint64& ch
 
     for (uint64 mut_i = 0; mut_i < n_muts; mut_i++) {
 
-        char c = (*(hap_chrom.ref_chrom))[muts.old_pos[mut_i]];
+        char c = (*(hap_chrom.ref_chrom))[muts.old_pos(mut_i)];
         uint64 i = base_inds[static_cast<uint64>(c)];
         sint64 smod = hap_chrom.size_modifier(mut_i);
         if (smod == 0) {
-            uint64 j = base_inds[static_cast<uint64>(muts.nucleos[mut_i][0])];
+            uint64 j = base_inds[static_cast<uint64>(muts.get_nucleo(mut_i, 0))];
             sub_mat(i, j)++;
         } else if (smod > 0) {
             uint64 j = static_cast<uint64>(smod - 1);
@@ -774,7 +771,7 @@ List examine_mutations(SEXP hap_set_ptr, const uint64& hap_ind, const uint64& ch
             del_mat(i, j)++;
         }
 
-        pos_vec[mut_i] = hap_chrom.mutations.old_pos[mut_i];
+        pos_vec[mut_i] = hap_chrom.mutations.old_pos(mut_i);
     }
 
     List out = List::create(
@@ -16,6 +16,7 @@
 #include <RcppArmadillo.h>
 #include <vector>
 #include <string>
+#include <algorithm>  // stable_sort
 #include <pcg/pcg_random.hpp> // pcg prng
 #include <progress.hpp>  // for the progress bar
 
@@ -219,6 +220,31 @@ inline void thread_check(uint64& n_threads) {
 
 
 
+//' Order of tasks from most to least expensive.
+//'
+//' Loops over tasks (e.g., chromosomes) iterate over this order using
+//' `#pragma omp for schedule(dynamic)`, so the largest tasks start first and
+//' idle threads pick up the smaller ones remaining.
+//' This keeps one large task from being left for the end of a static partition.
+//' Ties keep their original order.
+//'
+//' @param costs Expected cost of each task (only relative values matter).
+//'
+//' @noRd
+//'
+template <typename T>
+inline std::vector<uint64> cost_order(const std::vector<T>& costs) {
+    std::vector<uint64> order(costs.size());
+    for (uint64 i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&costs](const uint64& a, const uint64& b) {
+                         return costs[a] > costs[b];
+                     });
+    return order;
+}
+
+
+
 // For checking for user interrupts every N iterations:
 inline bool interrupt_check(uint32& iters,
                             Progress& prog_bar,